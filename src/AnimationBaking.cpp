@@ -0,0 +1,463 @@
+#include "AnimationBaking.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "ClipQuantization.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define AB_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(AB_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define AB_SSE2 1
+#endif
+
+/*same target handling as the vertex transform kernels*/
+#if defined(AB_SSE2) && defined(_MSC_VER)
+#define AB_AVX 1
+#define AB_TARGET_AVX
+#elif defined(AB_SSE2) && defined(__GNUC__)
+#define AB_AVX 1
+#define AB_TARGET_AVX __attribute__((target("avx")))
+#endif
+
+namespace
+{
+    /*
+    The interpolation of all bones and frames is staged in flat arrays of
+    four floats per sample, x, y, z, w for rotations and x, y, z, 0 for
+    translation and scale, so the kernels run over all samples at once.
+    */
+    struct Samples
+    {
+        std::vector<float> first;
+        std::vector<float> last;
+        std::vector<float> factors;
+        std::vector<float> result;
+
+        void resize(size_t count)
+        {
+            first.assign(count * 4, 0.0f);
+            last.assign(count * 4, 0.0f);
+            factors.assign(count, 0.0f);
+            result.assign(count * 4, 0.0f);
+        }
+    };
+
+    void store(const aiVector3D& v, float* p)
+    {
+        p[0] = v.x;
+        p[1] = v.y;
+        p[2] = v.z;
+        p[3] = 0.0f;
+    }
+
+    void store(const aiQuaternion& q, float* p)
+    {
+        p[0] = q.x;
+        p[1] = q.y;
+        p[2] = q.z;
+        p[3] = q.w;
+    }
+
+    /*
+    Finds the keys around every frame, the key index only moves forward so
+    no search is needed. Frames outside the keys take the nearest key.
+    @param Keys of the channel, sorted by time
+    @param Value used if the channel has no keys
+    @param Number of frames
+    @param Frames per second
+    @param Samples of the bone, frameCount entries starting at the offset
+    @param First sample of the bone*/
+    template<typename Key, typename Value>
+    void gather(const std::vector<Key>& keys, const Value& fallback, size_t frameCount, float rate, Samples& samples, size_t offset)
+    {
+        size_t k = 0;
+
+        for (size_t i = 0; i < frameCount; i++)
+        {
+            size_t s = offset + i;
+
+            if (keys.empty())
+            {
+                store(fallback, &samples.first[s * 4]);
+                store(fallback, &samples.last[s * 4]);
+                continue;
+            }
+
+            float time = i / rate;
+
+            while (k + 1 < keys.size() && keys[k + 1].timeStamp <= time)
+            {
+                k++;
+            }
+
+            const Key& first = keys[k];
+            const Key& last = keys[std::min(k + 1, keys.size() - 1)];
+            float duration = last.timeStamp - first.timeStamp;
+
+            samples.factors[s] = duration > 0.0f ? std::min(std::max((time - first.timeStamp) / duration, 0.0f), 1.0f) : 0.0f;
+            store(first.value, &samples.first[s * 4]);
+            store(last.value, &samples.last[s * 4]);
+        }
+    }
+
+    /*
+    Nlerp with a correction of the factor that makes the result follow slerp
+    closely, the correction depends on the angle between the quaternions.
+    The kernels below use the same operations in the same order and no FMA,
+    so every level bakes the same bits.
+    */
+    inline float correctFactor(float cosAngle, float t)
+    {
+        float a = 1.0904f + cosAngle * (-3.2452f + cosAngle * (3.55645f + cosAngle * -1.43519f));
+        float b = 0.848013f + cosAngle * (-1.06021f + cosAngle * 0.215638f);
+        float centered = t - 0.5f;
+        float k = a * (centered * centered) + b;
+
+        return t + (t * centered) * ((t - 1.0f) * k);
+    }
+
+    void blendRotationsScalar(const float* first, const float* last, const float* factors, float* result, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const float* a = first + i * 4;
+            const float* b = last + i * 4;
+            float* r = result + i * 4;
+
+            float d = (a[0] * b[0] + a[1] * b[1]) + (a[2] * b[2] + a[3] * b[3]);
+            float t = correctFactor(std::fabs(d), factors[i]);
+
+            /*the shorter arc*/
+            float wa = 1.0f - t;
+            float wb = std::signbit(d) ? -t : t;
+
+            for (int c = 0; c < 4; c++)
+            {
+                r[c] = a[c] * wa + b[c] * wb;
+            }
+
+            float length = std::sqrt((r[0] * r[0] + r[1] * r[1]) + (r[2] * r[2] + r[3] * r[3]));
+
+            for (int c = 0; c < 4; c++)
+            {
+                r[c] /= length;
+            }
+        }
+    }
+
+    void blendVectorsScalar(const float* first, const float* last, const float* factors, float* result, size_t count)
+    {
+        for (size_t i = 0; i < count * 4; i++)
+        {
+            result[i] = first[i] + (last[i] - first[i]) * factors[i / 4];
+        }
+    }
+
+#ifdef AB_SSE2
+    /*
+    Four rotations per iteration: the loaded quaternions are transposed so
+    every register holds one component of all four and the math is the same
+    as in the scalar kernel.
+    */
+    inline __m128 polynomial(__m128 x, float c0, float c1)
+    {
+        return _mm_add_ps(_mm_set1_ps(c0), _mm_mul_ps(x, _mm_set1_ps(c1)));
+    }
+
+    void blendRotationsSSE2(const float* first, const float* last, const float* factors, float* result, size_t count)
+    {
+        const __m128 signBit = _mm_set1_ps(-0.0f);
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 half = _mm_set1_ps(0.5f);
+
+        size_t i = 0;
+
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 ax = _mm_loadu_ps(first + i * 4);
+            __m128 ay = _mm_loadu_ps(first + i * 4 + 4);
+            __m128 az = _mm_loadu_ps(first + i * 4 + 8);
+            __m128 aw = _mm_loadu_ps(first + i * 4 + 12);
+            _MM_TRANSPOSE4_PS(ax, ay, az, aw);
+
+            __m128 bx = _mm_loadu_ps(last + i * 4);
+            __m128 by = _mm_loadu_ps(last + i * 4 + 4);
+            __m128 bz = _mm_loadu_ps(last + i * 4 + 8);
+            __m128 bw = _mm_loadu_ps(last + i * 4 + 12);
+            _MM_TRANSPOSE4_PS(bx, by, bz, bw);
+
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+            __m128 c = _mm_andnot_ps(signBit, d);
+            __m128 t = _mm_loadu_ps(factors + i);
+
+            __m128 pa = polynomial(c, 3.55645f, -1.43519f);
+            pa = _mm_add_ps(_mm_set1_ps(-3.2452f), _mm_mul_ps(c, pa));
+            pa = _mm_add_ps(_mm_set1_ps(1.0904f), _mm_mul_ps(c, pa));
+            __m128 pb = polynomial(c, -1.06021f, 0.215638f);
+            pb = _mm_add_ps(_mm_set1_ps(0.848013f), _mm_mul_ps(c, pb));
+
+            __m128 centered = _mm_sub_ps(t, half);
+            __m128 k = _mm_add_ps(_mm_mul_ps(pa, _mm_mul_ps(centered, centered)), pb);
+            t = _mm_add_ps(t, _mm_mul_ps(_mm_mul_ps(t, centered), _mm_mul_ps(_mm_sub_ps(t, one), k)));
+
+            __m128 wa = _mm_sub_ps(one, t);
+            __m128 wb = _mm_xor_ps(t, _mm_and_ps(d, signBit));
+
+            __m128 rx = _mm_add_ps(_mm_mul_ps(ax, wa), _mm_mul_ps(bx, wb));
+            __m128 ry = _mm_add_ps(_mm_mul_ps(ay, wa), _mm_mul_ps(by, wb));
+            __m128 rz = _mm_add_ps(_mm_mul_ps(az, wa), _mm_mul_ps(bz, wb));
+            __m128 rw = _mm_add_ps(_mm_mul_ps(aw, wa), _mm_mul_ps(bw, wb));
+
+            __m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)), _mm_add_ps(_mm_mul_ps(rz, rz), _mm_mul_ps(rw, rw)));
+            __m128 length = _mm_sqrt_ps(lengthSq);
+
+            rx = _mm_div_ps(rx, length);
+            ry = _mm_div_ps(ry, length);
+            rz = _mm_div_ps(rz, length);
+            rw = _mm_div_ps(rw, length);
+            _MM_TRANSPOSE4_PS(rx, ry, rz, rw);
+
+            _mm_storeu_ps(result + i * 4, rx);
+            _mm_storeu_ps(result + i * 4 + 4, ry);
+            _mm_storeu_ps(result + i * 4 + 8, rz);
+            _mm_storeu_ps(result + i * 4 + 12, rw);
+        }
+
+        blendRotationsScalar(first + i * 4, last + i * 4, factors + i, result + i * 4, count - i);
+    }
+
+    void blendVectorsSSE2(const float* first, const float* last, const float* factors, float* result, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            __m128 a = _mm_loadu_ps(first + i * 4);
+            __m128 b = _mm_loadu_ps(last + i * 4);
+
+            _mm_storeu_ps(result + i * 4, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(factors[i]))));
+        }
+    }
+#endif
+
+#ifdef AB_AVX
+    /*
+    Eight rotations per iteration, the low halves of the registers hold the
+    first four and the high halves the next four. The transpose works within
+    the halves, so the factors can be loaded in order.
+    */
+    AB_TARGET_AVX inline __m256 loadHalves(const float* low, const float* high)
+    {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(low)), _mm_loadu_ps(high), 1);
+    }
+
+    AB_TARGET_AVX inline void transpose(__m256& r0, __m256& r1, __m256& r2, __m256& r3)
+    {
+        __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+        __m256 t1 = _mm256_unpacklo_ps(r2, r3);
+        __m256 t2 = _mm256_unpackhi_ps(r0, r1);
+        __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+
+        r0 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+        r1 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+        r2 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        r3 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    }
+
+    AB_TARGET_AVX void blendRotationsAVX(const float* first, const float* last, const float* factors, float* result, size_t count)
+    {
+        const __m256 signBit = _mm256_set1_ps(-0.0f);
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 half = _mm256_set1_ps(0.5f);
+
+        size_t i = 0;
+
+        for (; i + 8 <= count; i += 8)
+        {
+            const float* a = first + i * 4;
+            const float* b = last + i * 4;
+
+            __m256 ax = loadHalves(a, a + 16);
+            __m256 ay = loadHalves(a + 4, a + 20);
+            __m256 az = loadHalves(a + 8, a + 24);
+            __m256 aw = loadHalves(a + 12, a + 28);
+            transpose(ax, ay, az, aw);
+
+            __m256 bx = loadHalves(b, b + 16);
+            __m256 by = loadHalves(b + 4, b + 20);
+            __m256 bz = loadHalves(b + 8, b + 24);
+            __m256 bw = loadHalves(b + 12, b + 28);
+            transpose(bx, by, bz, bw);
+
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)), _mm256_add_ps(_mm256_mul_ps(az, bz), _mm256_mul_ps(aw, bw)));
+            __m256 c = _mm256_andnot_ps(signBit, d);
+            __m256 t = _mm256_loadu_ps(factors + i);
+
+            __m256 pa = _mm256_add_ps(_mm256_set1_ps(3.55645f), _mm256_mul_ps(c, _mm256_set1_ps(-1.43519f)));
+            pa = _mm256_add_ps(_mm256_set1_ps(-3.2452f), _mm256_mul_ps(c, pa));
+            pa = _mm256_add_ps(_mm256_set1_ps(1.0904f), _mm256_mul_ps(c, pa));
+            __m256 pb = _mm256_add_ps(_mm256_set1_ps(-1.06021f), _mm256_mul_ps(c, _mm256_set1_ps(0.215638f)));
+            pb = _mm256_add_ps(_mm256_set1_ps(0.848013f), _mm256_mul_ps(c, pb));
+
+            __m256 centered = _mm256_sub_ps(t, half);
+            __m256 k = _mm256_add_ps(_mm256_mul_ps(pa, _mm256_mul_ps(centered, centered)), pb);
+            t = _mm256_add_ps(t, _mm256_mul_ps(_mm256_mul_ps(t, centered), _mm256_mul_ps(_mm256_sub_ps(t, one), k)));
+
+            __m256 wa = _mm256_sub_ps(one, t);
+            __m256 wb = _mm256_xor_ps(t, _mm256_and_ps(d, signBit));
+
+            __m256 rx = _mm256_add_ps(_mm256_mul_ps(ax, wa), _mm256_mul_ps(bx, wb));
+            __m256 ry = _mm256_add_ps(_mm256_mul_ps(ay, wa), _mm256_mul_ps(by, wb));
+            __m256 rz = _mm256_add_ps(_mm256_mul_ps(az, wa), _mm256_mul_ps(bz, wb));
+            __m256 rw = _mm256_add_ps(_mm256_mul_ps(aw, wa), _mm256_mul_ps(bw, wb));
+
+            __m256 lengthSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(rx, rx), _mm256_mul_ps(ry, ry)), _mm256_add_ps(_mm256_mul_ps(rz, rz), _mm256_mul_ps(rw, rw)));
+            __m256 length = _mm256_sqrt_ps(lengthSq);
+
+            rx = _mm256_div_ps(rx, length);
+            ry = _mm256_div_ps(ry, length);
+            rz = _mm256_div_ps(rz, length);
+            rw = _mm256_div_ps(rw, length);
+            transpose(rx, ry, rz, rw);
+
+            float* r = result + i * 4;
+            __m256 rows[4] = { rx, ry, rz, rw };
+
+            for (int j = 0; j < 4; j++)
+            {
+                _mm_storeu_ps(r + j * 4, _mm256_castps256_ps128(rows[j]));
+                _mm_storeu_ps(r + 16 + j * 4, _mm256_extractf128_ps(rows[j], 1));
+            }
+        }
+
+        blendRotationsSSE2(first + i * 4, last + i * 4, factors + i, result + i * 4, count - i);
+    }
+
+    AB_TARGET_AVX void blendVectorsAVX(const float* first, const float* last, const float* factors, float* result, size_t count)
+    {
+        size_t i = 0;
+
+        for (; i + 2 <= count; i += 2)
+        {
+            __m256 a = _mm256_loadu_ps(first + i * 4);
+            __m256 b = _mm256_loadu_ps(last + i * 4);
+            __m256 t = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(factors[i])), _mm_set1_ps(factors[i + 1]), 1);
+
+            _mm256_storeu_ps(result + i * 4, _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), t)));
+        }
+
+        blendVectorsSSE2(first + i * 4, last + i * 4, factors + i, result + i * 4, count - i);
+    }
+#endif
+
+    void blendRotations(Samples& samples, SimdLevel level)
+    {
+        size_t count = samples.factors.size();
+
+        switch (level)
+        {
+#ifdef AB_AVX
+        case SimdLevel::AVX:
+            blendRotationsAVX(samples.first.data(), samples.last.data(), samples.factors.data(), samples.result.data(), count);
+            return;
+#endif
+#ifdef AB_SSE2
+        case SimdLevel::SSE2:
+            blendRotationsSSE2(samples.first.data(), samples.last.data(), samples.factors.data(), samples.result.data(), count);
+            return;
+#endif
+        default:
+            blendRotationsScalar(samples.first.data(), samples.last.data(), samples.factors.data(), samples.result.data(), count);
+            return;
+        }
+    }
+
+    void blendVectors(Samples& samples, SimdLevel level)
+    {
+        size_t count = samples.factors.size();
+
+        switch (level)
+        {
+#ifdef AB_AVX
+        case SimdLevel::AVX:
+            blendVectorsAVX(samples.first.data(), samples.last.data(), samples.factors.data(), samples.result.data(), count);
+            return;
+#endif
+#ifdef AB_SSE2
+        case SimdLevel::SSE2:
+            blendVectorsSSE2(samples.first.data(), samples.last.data(), samples.factors.data(), samples.result.data(), count);
+            return;
+#endif
+        default:
+            blendVectorsScalar(samples.first.data(), samples.last.data(), samples.factors.data(), samples.result.data(), count);
+            return;
+        }
+    }
+}
+
+size_t bakeAnimation(Animation& animation, float rate, SimdLevel level)
+{
+    float duration = clipDuration(animation.channels);
+    size_t frameCount = (size_t)std::ceil(duration * rate - 0.001f) + 1;
+
+    std::vector<size_t> animated;
+
+    for (size_t b = 0; b < animation.channels.size(); b++)
+    {
+        if (!animation.channels[b].empty())
+        {
+            animated.push_back(b);
+        }
+    }
+
+    Samples translations;
+    Samples rotations;
+    Samples scales;
+
+    translations.resize(animated.size() * frameCount);
+    rotations.resize(animated.size() * frameCount);
+    scales.resize(animated.size() * frameCount);
+
+    KeyFrame defaults;
+
+    for (size_t a = 0; a < animated.size(); a++)
+    {
+        const BoneChannels& c = animation.channels[animated[a]];
+
+        gather(c.translation, defaults.translation, frameCount, rate, translations, a * frameCount);
+        gather(c.rotation, defaults.rotationQuat, frameCount, rate, rotations, a * frameCount);
+        gather(c.scale, defaults.scale, frameCount, rate, scales, a * frameCount);
+    }
+
+    blendVectors(translations, level);
+    blendRotations(rotations, level);
+    blendVectors(scales, level);
+
+    for (size_t a = 0; a < animated.size(); a++)
+    {
+        BoneChannels& c = animation.channels[animated[a]];
+        std::vector<KeyFrame>& keyframes = animation.keyframes[animated[a]];
+
+        c = BoneChannels();
+        keyframes.assign(frameCount, KeyFrame());
+
+        for (size_t i = 0; i < frameCount; i++)
+        {
+            size_t s = (a * frameCount + i) * 4;
+            KeyFrame& kf = keyframes[i];
+
+            kf.timeStamp = i / rate;
+            kf.translation = aiVector3D(translations.result[s], translations.result[s + 1], translations.result[s + 2]);
+            kf.rotationQuat = aiQuaternion(rotations.result[s + 3], rotations.result[s], rotations.result[s + 1], rotations.result[s + 2]);
+            kf.scale = aiVector3D(scales.result[s], scales.result[s + 1], scales.result[s + 2]);
+
+            c.translation.push_back({ kf.timeStamp, kf.translation });
+            c.rotation.push_back({ kf.timeStamp, kf.rotationQuat });
+            c.scale.push_back({ kf.timeStamp, kf.scale });
+        }
+    }
+
+    return frameCount;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "VertexTransform.h"
+#include "data.h"
+
+/*
+Resamples the channels of every animated bone at a fixed rate, frame i is at
+time i / rate and the last frame is at or after the end of the clip. The
+key frames and channels of the animation are replaced by the frames, so the
+engine can sample a clip by indexing without searching keys. Translation and
+scale are interpolated linearly, rotations with an approximated slerp that
+stays within 0.05 degrees of slerp. Missing channels of an animated bone use
+the defaults of KeyFrame, bones without animation stay empty.
+@returns Number of frames
+@param Animation with the source channels
+@param Frames per second
+@param Instruction set to use, must be supported by the CPU*/
+size_t bakeAnimation(Animation& animation, float rate, SimdLevel level);
@@ -0,0 +1,272 @@
+#include "AssetPack.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "Hash.h"
+#include "LZ4.h"
+#include "Parallel.h"
+
+bool writePack(const std::string& fileName, const std::vector<PackInput>& inputs, const PackOptions& options, PackStats& stats)
+{
+    stats = PackStats();
+
+    if (options.alignment == 0 || (options.alignment & (options.alignment - 1)) != 0)
+    {
+        std::cerr << "Pack alignment " << options.alignment << " is not a power of two!" << std::endl;
+        return false;
+    }
+
+    /*entry contents, compressed where it saves space*/
+    std::vector<std::vector<char>> contents(inputs.size());
+    std::vector<PackEntryRecord> entries(inputs.size(), PackEntryRecord{});
+    std::vector<char> readFailed(inputs.size(), 0);
+
+    parallelFor(inputs.size(), options.threads > 0 ? options.threads : defaultThreadCount(), [&](size_t i, unsigned)
+    {
+        MappedFile input;
+
+        if (!input.open(inputs[i].path))
+        {
+            readFailed[i] = 1;
+            return;
+        }
+
+        entries[i].Size = input.size();
+        entries[i].Compression = PACK_STORED;
+
+        /*empty files are stored as empty entries*/
+        if (input.size() == 0)
+        {
+            return;
+        }
+
+        if (options.compress)
+        {
+            std::vector<char> block;
+
+            if (compressLZ4(input.data(), input.size(), block) < input.size())
+            {
+                contents[i] = std::move(block);
+                entries[i].Compression = PACK_LZ4;
+                return;
+            }
+        }
+
+        contents[i].assign(input.data(), input.data() + input.size());
+    });
+
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        if (readFailed[i])
+        {
+            std::cerr << "Can not read " << inputs[i].path << "!" << std::endl;
+            return false;
+        }
+    }
+
+    /*names, followed by the data at aligned offsets in input order*/
+    std::string names;
+
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        entries[i].NameHash = fnv1a64(inputs[i].name);
+        entries[i].NameOffset = (UINT)names.size();
+        entries[i].NameLength = (UINT)inputs[i].name.size();
+        entries[i].StoredSize = contents[i].size();
+        names += inputs[i].name;
+    }
+
+    uint64_t offset = sizeof(PACK_MAGIC) + sizeof(PackHeaderRecord) + sizeof(PackEntryRecord) * entries.size() + names.size();
+
+    for (auto& e : entries)
+    {
+        offset = (offset + options.alignment - 1) & ~(uint64_t)(options.alignment - 1);
+        e.Offset = offset;
+        offset += e.StoredSize;
+    }
+
+    /*the directory is sorted by hash, equal hashes by name*/
+    std::vector<PackEntryRecord> directory = entries;
+
+    std::sort(directory.begin(), directory.end(), [&](const PackEntryRecord& a, const PackEntryRecord& b)
+    {
+        return a.NameHash != b.NameHash ? a.NameHash < b.NameHash :
+            names.compare(a.NameOffset, a.NameLength, names, b.NameOffset, b.NameLength) < 0;
+    });
+
+    for (size_t i = 1; i < directory.size(); i++)
+    {
+        const PackEntryRecord& a = directory[i - 1];
+        const PackEntryRecord& b = directory[i];
+
+        if (a.NameHash == b.NameHash && names.compare(a.NameOffset, a.NameLength, names, b.NameOffset, b.NameLength) == 0)
+        {
+            std::cerr << "The pack contains " << names.substr(a.NameOffset, a.NameLength) << " more than once!" << std::endl;
+            return false;
+        }
+    }
+
+    auto fileHandle = std::fstream(fileName, std::ios::out | std::ios::binary);
+
+    if (!fileHandle.is_open())
+    {
+        std::cerr << "Can not write " << fileName << "!" << std::endl;
+        return false;
+    }
+
+    PackHeaderRecord header = { PACK_FORMAT_VERSION, (UINT)entries.size(), options.alignment, (UINT)names.size() };
+
+    fileHandle.write(PACK_MAGIC, sizeof(PACK_MAGIC));
+    fileHandle.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    fileHandle.write(reinterpret_cast<const char*>(directory.data()), sizeof(PackEntryRecord) * directory.size());
+    fileHandle.write(names.data(), names.size());
+
+    std::vector<char> padding(options.alignment, 0);
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        uint64_t position = (uint64_t)fileHandle.tellp();
+        fileHandle.write(padding.data(), (std::streamsize)(entries[i].Offset - position));
+        fileHandle.write(contents[i].data(), contents[i].size());
+
+        stats.compressedEntries += entries[i].Compression != PACK_STORED ? 1 : 0;
+        stats.inputBytes += (long long)entries[i].Size;
+    }
+
+    stats.entries = entries.size();
+    stats.outputBytes = (long long)fileHandle.tellp();
+
+    if (!fileHandle.good())
+    {
+        std::cerr << "Can not write " << fileName << "!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool PackReader::open(const std::string& fileName)
+{
+    close();
+
+    if (!file.open(fileName))
+    {
+        return fail("Can not open file!");
+    }
+
+    PackHeaderRecord header;
+    size_t directoryOffset = sizeof(PACK_MAGIC) + sizeof(header);
+
+    if (file.size() < directoryOffset || memcmp(file.data(), PACK_MAGIC, sizeof(PACK_MAGIC)) != 0)
+    {
+        return fail("File contains incorrect header!");
+    }
+
+    memcpy(&header, file.data() + sizeof(PACK_MAGIC), sizeof(header));
+
+    if (header.Version != PACK_FORMAT_VERSION)
+    {
+        return fail("Unsupported pack version " + std::to_string(header.Version) + "!");
+    }
+
+    if (header.EntryCount > (file.size() - directoryOffset) / sizeof(PackEntryRecord) ||
+        header.NamesSize > file.size() - directoryOffset - sizeof(PackEntryRecord) * header.EntryCount)
+    {
+        return fail("Unexpected end of file in pack directory!");
+    }
+
+    alignment = header.Alignment;
+    entries.data = reinterpret_cast<const PackEntryRecord*>(file.data() + directoryOffset);
+    entries.size = header.EntryCount;
+    names = std::string_view(file.data() + directoryOffset + sizeof(PackEntryRecord) * header.EntryCount, header.NamesSize);
+
+    /*checked once here, so entries can be used without further checks*/
+    for (size_t i = 0; i < entries.size; i++)
+    {
+        const PackEntryRecord& e = entries[i];
+
+        if (e.NameOffset > names.size() || e.NameLength > names.size() - e.NameOffset ||
+            e.Offset > file.size() || e.StoredSize > file.size() - e.Offset)
+        {
+            return fail("Pack entry " + std::to_string(i) + " is outside of the file!");
+        }
+
+        if (e.Compression != PACK_STORED && e.Compression != PACK_LZ4)
+        {
+            return fail("Unsupported compression " + std::to_string(e.Compression) + " of " + std::string(getName(e)) + "!");
+        }
+
+        /*a LZ4 block expands at most 255 times, larger sizes would only allocate*/
+        if ((e.Compression == PACK_STORED && e.StoredSize != e.Size) || (e.Compression == PACK_LZ4 && e.Size / 255 > e.StoredSize) ||
+            (i > 0 && e.NameHash < entries[i - 1].NameHash))
+        {
+            return fail("Pack directory is corrupt!");
+        }
+    }
+
+    return true;
+}
+
+void PackReader::close()
+{
+    file.close();
+    alignment = 0;
+    entries = ArrayView<PackEntryRecord>();
+    names = std::string_view();
+    error.clear();
+}
+
+const PackEntryRecord* PackReader::find(std::string_view name) const
+{
+    uint64_t hash = fnv1a64(name.data(), name.size());
+
+    const PackEntryRecord* e = std::lower_bound(entries.begin(), entries.end(), hash,
+        [](const PackEntryRecord& entry, uint64_t h) { return entry.NameHash < h; });
+
+    for (; e != entries.end() && e->NameHash == hash; e++)
+    {
+        if (getName(*e) == name)
+        {
+            return e;
+        }
+    }
+
+    return nullptr;
+}
+
+bool PackReader::read(const PackEntryRecord& entry, std::vector<char>& buffer, std::string_view& data)
+{
+    if (entry.Size == 0)
+    {
+        data = std::string_view();
+        return true;
+    }
+
+    const char* stored = file.data() + entry.Offset;
+
+    if (entry.Compression == PACK_STORED)
+    {
+        data = std::string_view(stored, (size_t)entry.Size);
+        return true;
+    }
+
+    buffer.resize((size_t)entry.Size);
+
+    if (!decompressLZ4(stored, (size_t)entry.StoredSize, buffer.data(), buffer.size()))
+    {
+        return fail("Pack entry " + std::string(getName(entry)) + " is corrupt!");
+    }
+
+    data = std::string_view(buffer.data(), buffer.size());
+
+    return true;
+}
+
+bool PackReader::fail(const std::string& message)
+{
+    error = message;
+    return false;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "AssetReader.h"
+
+/*file to pack and its name inside the pack*/
+struct PackInput
+{
+    std::string path;
+    std::string name;
+};
+
+struct PackOptions
+{
+    bool compress = false; /*LZ4, only kept for entries it makes smaller*/
+    UINT alignment = 16; /*power of two, 4096 aligns the entries to pages*/
+    unsigned threads = 0; /*0 uses all cores*/
+};
+
+struct PackStats
+{
+    size_t entries = 0;
+    size_t compressedEntries = 0;
+    long long inputBytes = 0;
+    long long outputBytes = 0;
+};
+
+/*
+Writes files into a single pack, see PACK_MAGIC. The files are read and
+compressed in parallel, the entry data keeps the order of the inputs.
+@returns Success status
+@param Path of the pack
+@param Files to pack, names must be unique
+@param Compression and alignment
+@param Entry counts and sizes of the written pack*/
+bool writePack(const std::string& fileName, const std::vector<PackInput>& inputs, const PackOptions& options, PackStats& stats);
+
+/*
+Reader for packs. The pack is memory mapped and checked once on open,
+finding an entry is a binary search over the name hashes and stored entries
+are returned in place, e.g. for ModelReader::openData.
+*/
+class PackReader
+{
+public:
+    /*
+    Maps a pack and checks its directory.
+    @returns Success status, see getError() on failure
+    @param Path to the pack*/
+    bool open(const std::string& fileName);
+    void close();
+
+    /*
+    Finds an entry by name.
+    @returns Entry or nullptr if the pack has no such entry
+    @param Name of the entry, e.g. "characters/hero.s3d"*/
+    const PackEntryRecord* find(std::string_view name) const;
+
+    /*
+    Returns the contents of an entry. Stored entries point into the mapping,
+    compressed entries are decompressed into the buffer.
+    @returns Success status, see getError() on failure
+    @param Entry of this pack
+    @param Buffer for compressed entries, can be reused across entries
+    @param Contents, valid while the pack is open and the buffer unchanged*/
+    bool read(const PackEntryRecord& entry, std::vector<char>& buffer, std::string_view& data);
+
+    std::string_view getName(const PackEntryRecord& entry) const { return names.substr(entry.NameOffset, entry.NameLength); }
+    const ArrayView<PackEntryRecord>& getEntries() const { return entries; }
+    UINT getAlignment() const { return alignment; }
+    size_t getFileSize() const { return file.size(); }
+    const std::string& getError() const { return error; }
+
+private:
+    MappedFile file;
+    UINT alignment = 0;
+    ArrayView<PackEntryRecord> entries;
+    std::string_view names;
+    std::string error;
+
+    bool fail(const std::string& message);
+};
@@ -0,0 +1,790 @@
+#include "AssetReader.h"
+
+#include <cstring>
+#include <type_traits>
+
+namespace
+{
+    /*bounds checked sequential access to the mapped bytes*/
+    class ByteCursor
+    {
+    public:
+        ByteCursor(const char* data, size_t size) : current(data), end(data + size) {}
+
+        template<typename T>
+        bool read(T& value)
+        {
+            if ((size_t)(end - current) < sizeof(T))
+            {
+                return false;
+            }
+
+            memcpy(&value, current, sizeof(T));
+            current += sizeof(T);
+
+            return true;
+        }
+
+        template<typename T>
+        bool view(ArrayView<T>& result, size_t count)
+        {
+            if (count > (size_t)(end - current) / sizeof(T))
+            {
+                return false;
+            }
+
+            result.data = reinterpret_cast<const T*>(current);
+            result.size = count;
+            current += sizeof(T) * count;
+
+            return true;
+        }
+
+        template<typename T>
+        bool view(ScalarView<T>& result, size_t count)
+        {
+            if (count > (size_t)(end - current) / sizeof(T))
+            {
+                return false;
+            }
+
+            result.data = current;
+            result.size = count;
+            current += sizeof(T) * count;
+
+            return true;
+        }
+
+        template<typename T>
+        bool view(const T*& result)
+        {
+            ArrayView<T> single;
+
+            if (!view(single, 1))
+            {
+                return false;
+            }
+
+            result = single.data;
+
+            return true;
+        }
+
+        /*string with a length prefix of type T*/
+        template<typename T>
+        bool string(std::string_view& result)
+        {
+            T length = 0;
+
+            if (!read(length) || (std::is_signed<T>::value && length < 0) || (size_t)length > (size_t)(end - current))
+            {
+                return false;
+            }
+
+            result = std::string_view(current, (size_t)length);
+            current += length;
+
+            return true;
+        }
+
+        bool magic(const char* expected)
+        {
+            if ((size_t)(end - current) < 4 || memcmp(current, expected, 4) != 0)
+            {
+                return false;
+            }
+
+            current += 4;
+
+            return true;
+        }
+
+    private:
+        const char* current;
+        const char* end;
+    };
+
+    /*counts, bone ids and name lengths are single bytes and shorts before version 2*/
+    class ModelCursor : public ByteCursor
+    {
+    public:
+        ModelCursor(const ByteCursor& cursor, bool wide) : ByteCursor(cursor), wide(wide) {}
+
+        bool count(UINT& result)
+        {
+            BYTE narrow = 0;
+
+            if (wide)
+            {
+                return read(result);
+            }
+
+            if (!read(narrow))
+            {
+                return false;
+            }
+
+            result = narrow;
+
+            return true;
+        }
+
+        bool name(std::string_view& result)
+        {
+            return wide ? string<UINT>(result) : string<short>(result);
+        }
+
+    private:
+        bool wide;
+    };
+
+    /*
+    Parses a mesh of a B3D or S3D file.
+    @returns Success status
+    @param Cursor at the start of the mesh
+    @param Format flags of the file
+    @param true for S3D files
+    @param Parsed mesh
+    @param Error message on failure*/
+    bool parseMesh(ModelCursor& cursor, UINT flags, bool skinned, MeshView& m, std::string& message)
+    {
+        int vertCount = 0;
+        int indCount = 0;
+        UINT paletteSize = 0;
+
+        if ((flags & FORMAT_BONE_PALETTES) && (!cursor.read(paletteSize) || !cursor.view(m.bonePalette, paletteSize)))
+        {
+            message = "Unexpected end of file in bone palette!";
+            return false;
+        }
+
+        if (!cursor.name(m.materialName) || !cursor.read(vertCount) || vertCount < 0)
+        {
+            message = "Unexpected end of file in mesh data!";
+            return false;
+        }
+
+        bool vertsRead = false;
+
+        if (flags & FORMAT_QUANTIZED)
+        {
+            vertsRead = cursor.view(m.quantization) &&
+                (skinned ? cursor.view(m.quantizedSkinnedVertices, vertCount) : cursor.view(m.quantizedStaticVertices, vertCount));
+        }
+        else
+        {
+            vertsRead = skinned ? cursor.view(m.skinnedVertices, vertCount) : cursor.view(m.staticVertices, vertCount);
+        }
+
+        BYTE indexWidth = sizeof(UINT);
+
+        if (!vertsRead || ((flags & FORMAT_INDEX_WIDTH) && !cursor.read(indexWidth)) || !cursor.read(indCount) || indCount < 0)
+        {
+            message = "Unexpected end of file in mesh data!";
+            return false;
+        }
+
+        if (indexWidth != sizeof(uint16_t) && indexWidth != sizeof(UINT))
+        {
+            message = "Unsupported index width " + std::to_string(indexWidth) + "!";
+            return false;
+        }
+
+        if (indexWidth == sizeof(uint16_t) ? !cursor.view(m.shortIndices, indCount) : !cursor.view(m.indices, indCount))
+        {
+            message = "Unexpected end of file in mesh data!";
+            return false;
+        }
+
+        if (flags & FORMAT_MESHLETS)
+        {
+            UINT meshletCount = 0;
+            UINT vertexCount = 0;
+            UINT triangleCount = 0;
+
+            if (!cursor.read(meshletCount) || !cursor.view(m.meshlets, meshletCount) ||
+                !cursor.read(vertexCount) || !cursor.view(m.meshletVertices, vertexCount) ||
+                !cursor.read(triangleCount) || !cursor.view(m.meshletTriangles, (size_t)triangleCount * 3))
+            {
+                message = "Unexpected end of file in meshlet data!";
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /*full precision channel, the times followed by the values*/
+    template<typename T, typename Q>
+    bool readChannel(ByteCursor& cursor, UINT count, ChannelView<T, Q>& channel)
+    {
+        channel.size = count;
+
+        return cursor.view(channel.times, count) && cursor.view(channel.values, count);
+    }
+
+    /*quantized channel, see ChannelTimingRecord*/
+    template<typename T, typename Q>
+    bool readQuantizedChannel(ByteCursor& cursor, UINT count, float duration, ChannelView<T, Q>& channel)
+    {
+        channel.size = count;
+        channel.duration = duration;
+
+        if (count <= 1)
+        {
+            return cursor.view(channel.values, count);
+        }
+
+        if (!cursor.view(channel.timing) || (channel.timing->Interval == 0.0f && !cursor.view(channel.quantizedTimes, count)))
+        {
+            return false;
+        }
+
+        /*rotations need no range*/
+        if (std::is_same<Q, QuantizedVectorRecord>::value && !cursor.view(channel.range))
+        {
+            return false;
+        }
+
+        return cursor.view(channel.quantizedValues, count);
+    }
+}
+
+bool ModelReader::open(const std::string& fileName, UINT parts)
+{
+    close();
+
+    if (!file.open(fileName))
+    {
+        return fail("Can not open file!");
+    }
+
+    return parse(std::string_view(file.data(), file.size()), parts);
+}
+
+bool ModelReader::openData(const char* data, size_t size, UINT parts)
+{
+    close();
+
+    return parse(std::string_view(data, size), parts);
+}
+
+bool ModelReader::parse(std::string_view data, UINT parts)
+{
+    contents = data;
+    ByteCursor cursor(contents.data(), contents.size());
+
+    /*check header*/
+    if (cursor.magic(S3D_MAGIC))
+    {
+        skinned = true;
+    }
+    else if (cursor.magic(S3D_EXTENDED_MAGIC))
+    {
+        skinned = true;
+        extended = true;
+    }
+    else if (cursor.magic(B3D_EXTENDED_MAGIC))
+    {
+        extended = true;
+    }
+    else if (!cursor.magic(B3D_MAGIC))
+    {
+        return fail("File contains incorrect header!");
+    }
+
+    if (extended)
+    {
+        ExtendedHeaderRecord header;
+
+        if (!cursor.read(header))
+        {
+            return fail("Unexpected end of file in header!");
+        }
+
+        if (header.Version != EXTENDED_FORMAT_VERSION && header.Version != SECTIONED_FORMAT_VERSION)
+        {
+            return fail("Unsupported format version " + std::to_string(header.Version) + "!");
+        }
+
+        version = header.Version;
+        flags = header.Flags;
+    }
+
+    bool sectioned = version >= SECTIONED_FORMAT_VERSION;
+    ArrayView<SectionRecord> sectionTable;
+    UINT sectionCount = 0;
+
+    if (sectioned && (!cursor.read(sectionCount) || !cursor.view(sectionTable, sectionCount)))
+    {
+        return fail("Unexpected end of file in section table!");
+    }
+
+    sections.assign(sectionTable.begin(), sectionTable.end());
+
+    /*sections are parsed from their own range, older files continue sequentially*/
+    ModelCursor modelCursor(cursor, sectioned);
+
+    auto find = [&](UINT type) -> const SectionRecord*
+    {
+        for (const auto& section : sections)
+        {
+            if (section.Type == type && section.Offset <= contents.size() && section.Size <= contents.size() - section.Offset)
+            {
+                return &section;
+            }
+        }
+
+        return nullptr;
+    };
+
+    auto seek = [&](UINT type) -> bool
+    {
+        if (!sectioned)
+        {
+            return true;
+        }
+
+        const SectionRecord* section = find(type);
+
+        if (!section)
+        {
+            return fail("Missing section " + std::to_string(type) + "!");
+        }
+
+        modelCursor = ModelCursor(ByteCursor(contents.data() + section->Offset, (size_t)section->Size), true);
+
+        return true;
+    };
+
+    /*bone data only in s3d, sequential files always need it to reach the meshes*/
+    if (skinned && (!sectioned || (parts & READ_SKELETON)))
+    {
+        UINT numBones = 0;
+
+        if (!seek(SECTION_BONES))
+        {
+            return false;
+        }
+
+        if (!modelCursor.count(numBones) || numBones > contents.size())
+        {
+            return fail("Unexpected end of file in bone data!");
+        }
+
+        bones.resize(numBones);
+        boneCount = numBones;
+
+        for (auto& b : bones)
+        {
+            UINT id = 0;
+
+            if (!modelCursor.count(id) || !modelCursor.name(b.name) || !modelCursor.view(b.offsetMatrix))
+            {
+                return fail("Unexpected end of file in bone data!");
+            }
+
+            b.id = (int)id;
+        }
+
+        /*version 2 stores the pair count, older files have one pair per bone*/
+        UINT numPairs = numBones;
+
+        if (!seek(SECTION_BONE_HIERARCHY))
+        {
+            return false;
+        }
+
+        if ((sectioned && !modelCursor.read(numPairs)) || !modelCursor.view(boneHierarchy, numPairs))
+        {
+            return fail("Unexpected end of file in bone hierarchy!");
+        }
+
+        if (!seek(SECTION_NODES))
+        {
+            return false;
+        }
+
+        /*node tree, walked with an explicit stack of (node, remaining children)*/
+        std::vector<std::pair<int, UINT>> stack;
+
+        do
+        {
+            NodeView node;
+
+            if (!stack.empty())
+            {
+                stack.back().second--;
+                node.parent = stack.back().first;
+                node.depth = (int)stack.size();
+            }
+
+            if (!modelCursor.name(node.name) || !modelCursor.view(node.transform) || !modelCursor.read(node.numChildren))
+            {
+                return fail("Unexpected end of file in node tree!");
+            }
+
+            nodes.push_back(node);
+            stack.push_back(std::pair<int, UINT>((int)nodes.size() - 1, node.numChildren));
+
+            while (!stack.empty() && stack.back().second == 0)
+            {
+                stack.pop_back();
+            }
+        } while (!stack.empty());
+    }
+    else if (skinned)
+    {
+        /*only the bone count, validate() checks the influences against it*/
+        if (!seek(SECTION_BONES))
+        {
+            return false;
+        }
+
+        if (!modelCursor.count(boneCount))
+        {
+            return fail("Unexpected end of file in bone data!");
+        }
+    }
+
+    /*with a mesh index the meshes can be left to readMesh*/
+    if (!(parts & READ_MESHES) && find(SECTION_MESH_INDEX))
+    {
+        UINT numIndexed = 0;
+
+        if (!seek(SECTION_MESH_INDEX) || !modelCursor.read(numIndexed) || !modelCursor.view(meshIndex, numIndexed))
+        {
+            return fail("Unexpected end of file in mesh index!");
+        }
+
+        return true;
+    }
+
+    /*mesh data for both formats*/
+    UINT numMeshes = 0;
+
+    if (!seek(SECTION_MESHES))
+    {
+        return false;
+    }
+
+    if (!modelCursor.count(numMeshes) || numMeshes > contents.size())
+    {
+        return fail("Unexpected end of file in mesh data!");
+    }
+
+    meshes.resize(numMeshes);
+    meshesLoaded = true;
+
+    for (auto& m : meshes)
+    {
+        std::string message;
+
+        if (!parseMesh(modelCursor, flags, skinned, m, message))
+        {
+            return fail(message);
+        }
+    }
+
+    return true;
+}
+
+void ModelReader::close()
+{
+    file.close();
+    contents = std::string_view();
+    skinned = false;
+    extended = false;
+    version = 0;
+    flags = 0;
+    bones.clear();
+    boneCount = 0;
+    boneHierarchy = ArrayView<BoneHierarchyRecord>();
+    nodes.clear();
+    meshes.clear();
+    meshesLoaded = false;
+    meshIndex = ArrayView<MeshIndexRecord>();
+    sections.clear();
+    error.clear();
+}
+
+size_t ModelReader::getMeshCount() const
+{
+    return meshesLoaded ? meshes.size() : meshIndex.size;
+}
+
+bool ModelReader::readMesh(size_t index, MeshView& mesh)
+{
+    if (index >= getMeshCount())
+    {
+        return fail("Mesh " + std::to_string(index) + " does not exist!");
+    }
+
+    if (meshesLoaded)
+    {
+        mesh = meshes[index];
+        return true;
+    }
+
+    const MeshIndexRecord& entry = meshIndex[index];
+
+    if (entry.Offset > contents.size() || entry.Size > contents.size() - entry.Offset)
+    {
+        return fail("Mesh " + std::to_string(index) + " is outside of the file!");
+    }
+
+    ModelCursor cursor(ByteCursor(contents.data() + entry.Offset, (size_t)entry.Size), true);
+    std::string message;
+    mesh = MeshView();
+
+    if (!parseMesh(cursor, flags, skinned, mesh, message))
+    {
+        return fail(message);
+    }
+
+    return true;
+}
+
+bool ModelReader::validate()
+{
+    for (const auto& h : boneHierarchy)
+    {
+        if (h.Bone < 0 || h.Bone >= (int)bones.size() || h.Parent < -1 || h.Parent >= (int)bones.size())
+        {
+            return fail("Bone hierarchy references a bone that does not exist!");
+        }
+    }
+
+    /*meshes left to readMesh are parsed through the mesh index*/
+    for (size_t i = 0; i < getMeshCount(); i++)
+    {
+        MeshView m;
+
+        if (!readMesh(i, m) || !validateMesh(i, m))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool ModelReader::validateMesh(size_t i, const MeshView& m)
+{
+    UINT vertCount = (UINT)m.vertexCount();
+
+    for (size_t j = 0; j < m.indexCount(); j++)
+    {
+        UINT index = m.index(j);
+
+        if (index >= vertCount)
+        {
+            return fail("Mesh " + std::to_string(i) + " references vertex " + std::to_string(index) + " out of " + std::to_string(vertCount) + "!");
+        }
+    }
+
+    for (const auto& meshlet : m.meshlets)
+    {
+        if ((size_t)meshlet.VertexOffset + meshlet.VertexCount > m.meshletVertices.size ||
+            (size_t)meshlet.TriangleOffset + meshlet.TriangleCount * 3 > m.meshletTriangles.size)
+        {
+            return fail("Mesh " + std::to_string(i) + " has a meshlet outside of the meshlet data!");
+        }
+
+        for (size_t k = 0; k < meshlet.TriangleCount * 3; k++)
+        {
+            if (m.meshletTriangles[meshlet.TriangleOffset + k] >= meshlet.VertexCount)
+            {
+                return fail("Mesh " + std::to_string(i) + " has a meshlet triangle referencing a vertex outside of its meshlet!");
+            }
+        }
+    }
+
+    for (UINT index : m.meshletVertices)
+    {
+        if (index >= vertCount)
+        {
+            return fail("Mesh " + std::to_string(i) + " has a meshlet vertex " + std::to_string(index) + " out of " + std::to_string(vertCount) + "!");
+        }
+    }
+
+    for (UINT bone : m.bonePalette)
+    {
+        if (bone >= boneCount)
+        {
+            return fail("Mesh " + std::to_string(i) + " has bone " + std::to_string(bone) + " in its palette that does not exist!");
+        }
+    }
+
+    /*with palettes blend indices are palette slots*/
+    size_t indexedBones = (flags & FORMAT_BONE_PALETTES) ? m.bonePalette.size : boneCount;
+
+    for (const auto& v : m.skinnedVertices)
+    {
+        for (const auto& influence : v.Influences)
+        {
+            if (influence.Weight > 0.0f && influence.Index >= indexedBones)
+            {
+                return fail("Mesh " + std::to_string(i) + " references bone " + std::to_string(influence.Index) + " that does not exist!");
+            }
+        }
+    }
+
+    for (const auto& v : m.quantizedSkinnedVertices)
+    {
+        for (int k = 0; k < MAX_BONE_INFLUENCES; k++)
+        {
+            if (v.BlendWeights[k] > 0 && v.BlendIndices[k] >= indexedBones)
+            {
+                return fail("Mesh " + std::to_string(i) + " references bone " + std::to_string(v.BlendIndices[k]) + " that does not exist!");
+            }
+        }
+    }
+
+    return true;
+}
+
+bool ModelReader::fail(const std::string& message)
+{
+    error = message;
+    return false;
+}
+
+bool ClipReader::open(const std::string& fileName)
+{
+    close();
+
+    if (!file.open(fileName))
+    {
+        return fail("Can not open file!");
+    }
+
+    return parse(std::string_view(file.data(), file.size()));
+}
+
+bool ClipReader::openData(const char* data, size_t size)
+{
+    close();
+
+    return parse(std::string_view(data, size));
+}
+
+bool ClipReader::parse(std::string_view data)
+{
+    contents = data;
+    ByteCursor cursor(contents.data(), contents.size());
+
+    if (cursor.magic(CLP_EXTENDED_MAGIC))
+    {
+        extended = true;
+    }
+    else if (!cursor.magic(CLP_MAGIC))
+    {
+        return fail("File contains incorrect header!");
+    }
+
+    if (extended)
+    {
+        ExtendedHeaderRecord header;
+
+        if (!cursor.read(header))
+        {
+            return fail("Unexpected end of file in header!");
+        }
+
+        if (header.Version != EXTENDED_FORMAT_VERSION)
+        {
+            return fail("Unsupported format version " + std::to_string(header.Version) + "!");
+        }
+
+        version = header.Version;
+        flags = header.Flags;
+    }
+
+    int numBones = 0;
+
+    /*every track takes at least one byte, larger counts would only allocate*/
+    if (!cursor.string<int>(name) || !cursor.read(numBones) || numBones < 0 || (size_t)numBones > contents.size())
+    {
+        return fail("Unexpected end of file in clip header!");
+    }
+
+    bool quantized = (flags & CLIP_QUANTIZED) != 0;
+    float duration = 0.0f;
+
+    if (quantized && !cursor.read(duration))
+    {
+        return fail("Unexpected end of file in clip header!");
+    }
+
+    tracks.resize(numBones);
+
+    for (auto& t : tracks)
+    {
+        if (flags & CLIP_CHANNELS)
+        {
+            ChannelCountsRecord counts;
+
+            if (!cursor.read(counts))
+            {
+                return fail("Unexpected end of file in channels!");
+            }
+
+            bool complete = quantized ?
+                readQuantizedChannel(cursor, counts.Translation, duration, t.translation) &&
+                readQuantizedChannel(cursor, counts.Rotation, duration, t.rotation) &&
+                readQuantizedChannel(cursor, counts.Scale, duration, t.scale) :
+                readChannel(cursor, counts.Translation, t.translation) &&
+                readChannel(cursor, counts.Rotation, t.rotation) &&
+                readChannel(cursor, counts.Scale, t.scale);
+
+            if (!complete)
+            {
+                return fail("Unexpected end of file in channels!");
+            }
+
+            t.isEmpty = counts.Translation == 0 && counts.Rotation == 0 && counts.Scale == 0;
+            continue;
+        }
+
+        int numKeyFrames = 0;
+
+        if (!cursor.read(numKeyFrames))
+        {
+            return fail("Unexpected end of file in key frames!");
+        }
+
+        /*bones without animation are marked with -1*/
+        if (numKeyFrames == -1)
+        {
+            continue;
+        }
+
+        if (numKeyFrames < 0 || !cursor.view(t.keyFrames, numKeyFrames))
+        {
+            return fail("Unexpected end of file in key frames!");
+        }
+
+        t.isEmpty = false;
+    }
+
+    return true;
+}
+
+void ClipReader::close()
+{
+    file.close();
+    contents = std::string_view();
+    extended = false;
+    version = 0;
+    flags = 0;
+    name = std::string_view();
+    tracks.clear();
+    error.clear();
+}
+
+bool ClipReader::fail(const std::string& message)
+{
+    error = message;
+    return false;
+}
@@ -0,0 +1,333 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Format.h"
+#include "MappedFile.h"
+
+/*
+Zero-copy readers for B3D, S3D and CLP files. The file is memory mapped and
+all views point directly into the mapping, they stay valid until the reader
+is closed or destroyed. Records inside the files are not aligned, the views
+therefore use the packed record types from Format.h and scalars are copied
+out by ScalarView.
+*/
+
+/*read-only view of consecutive records inside a mapped file*/
+template<typename T>
+struct ArrayView
+{
+    static_assert(alignof(T) == 1, "Records in mapped files are not aligned, use a packed record or ScalarView");
+
+    const T* data = nullptr;
+    size_t size = 0;
+
+    const T& operator[](size_t i) const { return data[i]; }
+    const T* begin() const { return data; }
+    const T* end() const { return data + size; }
+    bool empty() const { return size == 0; }
+};
+
+/*read-only view of consecutive scalars inside a mapped file, every value is copied out as it may not be aligned*/
+template<typename T>
+struct ScalarView
+{
+    struct Iterator
+    {
+        const char* position;
+
+        T operator*() const
+        {
+            T value;
+            memcpy(&value, position, sizeof(T));
+            return value;
+        }
+
+        Iterator& operator++() { position += sizeof(T); return *this; }
+        bool operator!=(const Iterator& other) const { return position != other.position; }
+    };
+
+    const char* data = nullptr;
+    size_t size = 0;
+
+    T operator[](size_t i) const { return *Iterator{ data + i * sizeof(T) }; }
+    Iterator begin() const { return { data }; }
+    Iterator end() const { return { data + size * sizeof(T) }; }
+    bool empty() const { return size == 0; }
+};
+
+struct BoneView
+{
+    int id = -1;
+    std::string_view name;
+    const MatrixRecord* offsetMatrix = nullptr;
+};
+
+/*node of the node tree, nodes are stored in depth-first order*/
+struct NodeView
+{
+    std::string_view name;
+    const MatrixRecord* transform = nullptr;
+    UINT numChildren = 0;
+    int parent = -1;
+    int depth = 0;
+};
+
+/*mesh of a model, only one of the vertex views is filled depending on the format*/
+struct MeshView
+{
+    std::string_view materialName;
+    ArrayView<StaticVertexRecord> staticVertices;
+    ArrayView<SkinnedVertexRecord> skinnedVertices;
+    ArrayView<QuantizedStaticVertexRecord> quantizedStaticVertices;
+    ArrayView<QuantizedSkinnedVertexRecord> quantizedSkinnedVertices;
+    const QuantizationRecord* quantization = nullptr;
+    /*only one of the index views is filled depending on the index width of the mesh*/
+    ScalarView<UINT> indices;
+    ScalarView<uint16_t> shortIndices;
+
+    /*bone of every blend index, empty unless the file has bone palettes*/
+    ScalarView<UINT> bonePalette;
+
+    /*meshlets, empty unless the file has the meshlet section*/
+    ArrayView<MeshletRecord> meshlets;
+    ScalarView<UINT> meshletVertices;
+    ArrayView<BYTE> meshletTriangles;
+
+    size_t vertexCount() const
+    {
+        return staticVertices.size + skinnedVertices.size + quantizedStaticVertices.size + quantizedSkinnedVertices.size;
+    }
+
+    size_t indexCount() const
+    {
+        return indices.size + shortIndices.size;
+    }
+
+    /*byte width of the stored indices*/
+    size_t indexWidth() const
+    {
+        return shortIndices.data ? sizeof(uint16_t) : sizeof(UINT);
+    }
+
+    UINT index(size_t i) const
+    {
+        return shortIndices.data ? shortIndices[i] : indices[i];
+    }
+
+    /*vertex without bone data, quantized vertices are decoded*/
+    StaticVertexRecord vertex(size_t i) const
+    {
+        return skinnedVertex(i).Base;
+    }
+
+    /*vertex with bone data, all influences are zero for static meshes*/
+    SkinnedVertexRecord skinnedVertex(size_t i) const
+    {
+        SkinnedVertexRecord result = {};
+
+        if (skinnedVertices.data)
+        {
+            result = skinnedVertices[i];
+        }
+        else if (staticVertices.data)
+        {
+            result.Base = staticVertices[i];
+        }
+        else if (quantizedSkinnedVertices.data)
+        {
+            unpackVertex(quantizedSkinnedVertices[i], *quantization, result);
+        }
+        else
+        {
+            unpackVertex(quantizedStaticVertices[i], *quantization, result.Base);
+        }
+
+        return result;
+    }
+};
+
+/*
+Channel of a channel clip, a single key is a constant value. Full precision
+channels fill times and values, quantized channels are decoded by time() and
+value().
+*/
+template<typename T, typename Q>
+struct ChannelView
+{
+    size_t size = 0;
+    ScalarView<float> times;
+    ArrayView<T> values;
+
+    /*quantized channels, values holds the key of constant channels*/
+    float duration = 0.0f;
+    const ChannelTimingRecord* timing = nullptr;
+    ScalarView<uint16_t> quantizedTimes;
+    const ChannelRangeRecord* range = nullptr;
+    ArrayView<Q> quantizedValues;
+
+    float time(size_t i) const
+    {
+        if (times.data)
+        {
+            return times[i];
+        }
+
+        if (quantizedTimes.data)
+        {
+            return unpackTime(quantizedTimes[i], duration);
+        }
+
+        return timing ? timing->Start + i * timing->Interval : 0.0f;
+    }
+
+    T value(size_t i) const
+    {
+        if (values.data)
+        {
+            return values[i];
+        }
+
+        T result;
+        unpackKey(quantizedValues[i], range, result);
+
+        return result;
+    }
+};
+
+/*key frames of a single bone, channel clips fill the channels instead of keyFrames*/
+struct TrackView
+{
+    bool isEmpty = true;
+    ArrayView<KeyFrameRecord> keyFrames;
+    ChannelView<VectorRecord, QuantizedVectorRecord> translation;
+    ChannelView<QuaternionRecord, QuantizedQuaternionRecord> rotation;
+    ChannelView<VectorRecord, QuantizedVectorRecord> scale;
+};
+
+/*parts of a model for ModelReader::open*/
+const UINT READ_SKELETON = 1 << 0; /*bones, bone hierarchy and node tree*/
+const UINT READ_MESHES = 1 << 1;
+const UINT READ_ALL = READ_SKELETON | READ_MESHES;
+
+/*reader for B3D and S3D files*/
+class ModelReader
+{
+public:
+    /*
+    Maps a B3D or S3D file and parses the requested parts. Version 2 files
+    skip the skeleton unless it is requested and, if they have a mesh index,
+    leave the meshes to readMesh unless they are requested. Older files are
+    sequential and always parsed completely.
+    @returns Success status, see getError() on failure
+    @param Path to the file
+    @param Parts to parse, see READ_ALL*/
+    bool open(const std::string& fileName, UINT parts = READ_ALL);
+
+    /*
+    Parses a B3D or S3D file that is already in memory, e.g. an entry of a
+    pack. The views point into the data, it has to outlive the reader.
+    @returns Success status, see getError() on failure
+    @param File contents
+    @param Size in bytes
+    @param Parts to parse, see READ_ALL*/
+    bool openData(const char* data, size_t size, UINT parts = READ_ALL);
+    void close();
+
+    /*number of meshes in the file, parsed or not*/
+    size_t getMeshCount() const;
+
+    /*
+    Parses a single mesh through the mesh index without touching the other
+    meshes, meshes parsed by open are returned directly. The mesh is not
+    checked, see validate().
+    @returns Success status, see getError() on failure
+    @param Index of the mesh
+    @param Parsed mesh, valid as long as the file is open*/
+    bool readMesh(size_t index, MeshView& mesh);
+
+    /*
+    Checks that all indices reference existing vertices and all influences
+    reference existing bones. Meshes left to readMesh are parsed and checked
+    as well, so the whole file is read.
+    @returns true if the model is consistent, see getError() otherwise*/
+    bool validate();
+
+    bool isSkinned() const { return skinned; }
+    bool isExtended() const { return extended; }
+    UINT getVersion() const { return version; }
+    UINT getFlags() const { return flags; }
+    const std::vector<BoneView>& getBones() const { return bones; }
+    const ArrayView<BoneHierarchyRecord>& getBoneHierarchy() const { return boneHierarchy; }
+    const std::vector<NodeView>& getNodes() const { return nodes; }
+    /*meshes parsed by open, empty if they were left to readMesh*/
+    const std::vector<MeshView>& getMeshes() const { return meshes; }
+    /*section table of version 2 files, empty for older files*/
+    const std::vector<SectionRecord>& getSections() const { return sections; }
+    size_t getFileSize() const { return contents.size(); }
+    const std::string& getError() const { return error; }
+
+private:
+    MappedFile file;
+    std::string_view contents;
+    bool skinned = false;
+    bool extended = false;
+    UINT version = 0;
+    UINT flags = 0;
+    std::vector<BoneView> bones;
+    UINT boneCount = 0; /*also known if the skeleton was not parsed*/
+    ArrayView<BoneHierarchyRecord> boneHierarchy;
+    std::vector<NodeView> nodes;
+    std::vector<MeshView> meshes;
+    bool meshesLoaded = false;
+    ArrayView<MeshIndexRecord> meshIndex;
+    std::vector<SectionRecord> sections;
+    std::string error;
+
+    bool parse(std::string_view data, UINT parts);
+    bool validateMesh(size_t index, const MeshView& mesh);
+    bool fail(const std::string& message);
+};
+
+/*reader for CLP files*/
+class ClipReader
+{
+public:
+    /*
+    Maps and parses a CLP file.
+    @returns Success status, see getError() on failure
+    @param Path to the file*/
+    bool open(const std::string& fileName);
+
+    /*
+    Parses a CLP file that is already in memory, see ModelReader::openData.
+    @returns Success status, see getError() on failure
+    @param File contents
+    @param Size in bytes*/
+    bool openData(const char* data, size_t size);
+    void close();
+
+    bool isExtended() const { return extended; }
+    UINT getVersion() const { return version; }
+    UINT getFlags() const { return flags; }
+    std::string_view getName() const { return name; }
+    const std::vector<TrackView>& getTracks() const { return tracks; }
+    size_t getFileSize() const { return contents.size(); }
+    const std::string& getError() const { return error; }
+
+private:
+    MappedFile file;
+    std::string_view contents;
+    bool extended = false;
+    UINT version = 0;
+    UINT flags = 0;
+    std::string_view name;
+    std::vector<TrackView> tracks;
+    std::string error;
+
+    bool parse(std::string_view data);
+    bool fail(const std::string& message);
+};
@@ -0,0 +1,175 @@
+#include "BonePalette.h"
+
+#include <algorithm>
+
+namespace
+{
+    /*palette and triangles of a part of a mesh*/
+    struct Part
+    {
+        std::vector<UINT> palette;
+        std::vector<int> slots; /*palette slot of every bone of the model, -1 if unused*/
+        std::vector<size_t> triangles;
+    };
+
+    /*distinct bones of a triangle, only influences in use count*/
+    size_t triangleBones(const UnifiedMesh& mesh, size_t t, UINT* bones)
+    {
+        size_t count = 0;
+
+        for (int c = 0; c < 3; c++)
+        {
+            const Vertex& v = mesh.vertices[mesh.indices[t * 3 + c]];
+
+            for (BYTE k = 0; k < v.NumInfluences; k++)
+            {
+                if (std::find(bones, bones + count, v.BlendIndices[k]) == bones + count)
+                {
+                    bones[count++] = v.BlendIndices[k];
+                }
+            }
+        }
+
+        return count;
+    }
+
+    UnifiedMesh buildPart(const UnifiedMesh& mesh, const Part& part)
+    {
+        UnifiedMesh result;
+
+        result.materialName = mesh.materialName;
+        result.rootTransform = mesh.rootTransform;
+        result.bonePalette = part.palette;
+
+        /*vertices in order of first use*/
+        std::vector<int> remap(mesh.vertices.size(), -1);
+        result.indices.reserve(part.triangles.size() * 3);
+
+        for (size_t t : part.triangles)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                UINT v = mesh.indices[t * 3 + c];
+
+                if (remap[v] < 0)
+                {
+                    remap[v] = (int)result.vertices.size();
+
+                    Vertex vertex = mesh.vertices[v];
+
+                    for (BYTE k = 0; k < vertex.NumInfluences; k++)
+                    {
+                        vertex.BlendIndices[k] = (UINT)part.slots[vertex.BlendIndices[k]];
+                    }
+
+                    result.vertices.push_back(vertex);
+                }
+
+                result.indices.push_back((UINT)remap[v]);
+            }
+        }
+
+        return result;
+    }
+}
+
+std::vector<UnifiedMesh> splitByBonePalette(const UnifiedMesh& mesh, size_t maxBones)
+{
+    UINT boneCount = 0;
+
+    for (const auto& v : mesh.vertices)
+    {
+        for (BYTE k = 0; k < v.NumInfluences; k++)
+        {
+            boneCount = std::max(boneCount, v.BlendIndices[k] + 1);
+        }
+    }
+
+    std::vector<Part> parts;
+    UINT bones[3 * MAX_BONE_INFLUENCES];
+
+    for (size_t t = 0; t < mesh.indices.size() / 3; t++)
+    {
+        size_t count = triangleBones(mesh, t, bones);
+        Part* target = nullptr;
+
+        for (auto& part : parts)
+        {
+            size_t added = std::count_if(bones, bones + count, [&](UINT b) { return part.slots[b] < 0; });
+
+            if (part.palette.size() + added <= maxBones)
+            {
+                target = &part;
+                break;
+            }
+        }
+
+        if (!target)
+        {
+            parts.emplace_back();
+            target = &parts.back();
+            target->slots.assign(boneCount, -1);
+        }
+
+        for (size_t k = 0; k < count; k++)
+        {
+            if (target->slots[bones[k]] < 0)
+            {
+                target->slots[bones[k]] = (int)target->palette.size();
+                target->palette.push_back(bones[k]);
+            }
+        }
+
+        target->triangles.push_back(t);
+    }
+
+    std::vector<UnifiedMesh> result;
+
+    /*a mesh that fits keeps its vertex order, only the blend indices change*/
+    if (parts.size() <= 1)
+    {
+        Part all;
+        all.slots.assign(boneCount, -1);
+
+        for (const auto& v : mesh.vertices)
+        {
+            for (BYTE k = 0; k < v.NumInfluences; k++)
+            {
+                if (all.slots[v.BlendIndices[k]] < 0)
+                {
+                    all.slots[v.BlendIndices[k]] = (int)all.palette.size();
+                    all.palette.push_back(v.BlendIndices[k]);
+                }
+            }
+        }
+
+        if (all.palette.size() <= maxBones)
+        {
+            result.push_back(mesh);
+            result.back().bonePalette = all.palette;
+
+            for (auto& v : result.back().vertices)
+            {
+                for (BYTE k = 0; k < v.NumInfluences; k++)
+                {
+                    v.BlendIndices[k] = (UINT)all.slots[v.BlendIndices[k]];
+                }
+            }
+
+            return result;
+        }
+    }
+
+    /*without triangles there is nothing to draw, the unused vertices are dropped like in the parts*/
+    if (parts.empty())
+    {
+        parts.emplace_back();
+    }
+
+    for (const auto& part : parts)
+    {
+        result.push_back(buildPart(mesh, part));
+    }
+
+    return result;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vector>
+
+#include "data.h"
+
+/*default palette size, small enough for a constant buffer of skinning matrices*/
+const size_t DEFAULT_BONE_PALETTE_SIZE = 64;
+
+/*
+Gives a skinned mesh a bone palette of at most maxBones bones and remaps the
+blend indices of its vertices to palette slots. A mesh referencing more
+bones is split, every triangle goes to the first part whose palette can take
+its bones. Parts keep the material and root transform of the mesh and only
+the vertices their triangles use.
+@returns The mesh itself or its parts, each with its bonePalette
+@param Mesh with blend indices into the bones of the model
+@param Largest palette size, at least 3 * MAX_BONE_INFLUENCES so every triangle fits*/
+std::vector<UnifiedMesh> splitByBonePalette(const UnifiedMesh& mesh, size_t maxBones);
@@ -0,0 +1,250 @@
+#include "BuildCache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <assimp\version.h>
+
+#include "Format.h"
+#include "Hash.h"
+#include "MappedFile.h"
+#include "Version.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const char* LIST_FILE = "outputs.txt";
+    const char* INPUT_FILE = "inputs.txt";
+
+    /*hash of the bytes of a file, false if it can not be read*/
+    bool hashFile(const std::string& fileName, uint64_t& hash)
+    {
+        MappedFile file;
+
+        if (!file.open(fileName))
+        {
+            return false;
+        }
+
+        hash = fnv1a64(file.data(), file.size());
+
+        return true;
+    }
+
+    /*every option that changes the output, the output directory and thread count do not*/
+    std::string describeOptions(const InitData& initData)
+    {
+        std::ostringstream os;
+
+        os << "converter " << VERSION_MAJOR << "." << VERSION_MINOR << "\n";
+        os << "assimp " << aiGetVersionMajor() << "." << aiGetVersionMinor() << "." << aiGetVersionRevision() << "\n";
+        os << "influences " << MAX_BONE_INFLUENCES << "\n";
+        os << "formats " << EXTENDED_FORMAT_VERSION << " " << SECTIONED_FORMAT_VERSION << "\n";
+        os << "name " << fs::path(initData.fileName).filename().string() << "\n";
+        os << "scale " << std::hexfloat << initData.scaleFactor << std::defaultfloat << "\n";
+        os << "center " << initData.centerEnabled << "\n";
+        os << "prefix " << initData.prefix << "\n";
+        os << "static " << initData.forceStatic << "\n";
+        os << "transform " << initData.forceTransform << "\n";
+        os << "pp " << initData.postProcess << "\n";
+        os << "optimize " << initData.optimizeMeshes << "\n";
+        os << "quantize " << initData.quantize << "\n";
+        os << "shortindices " << initData.shortIndices << "\n";
+        os << "meshlets " << initData.meshlets << "\n";
+        os << "keyreduction " << initData.reduceKeyFrames << " " << std::hexfloat << initData.keyFrameTolerance.translation << " "
+            << initData.keyFrameTolerance.rotation << " " << initData.keyFrameTolerance.scale << std::defaultfloat << "\n";
+        os << "channels " << initData.channelClips << "\n";
+        os << "quantizeclips " << initData.quantizeClips << "\n";
+        os << "bake " << std::hexfloat << initData.bakeRate << std::defaultfloat << "\n";
+        os << "palette " << initData.bonePaletteSize << "\n";
+        os << "lods";
+
+        for (float ratio : initData.lods)
+        {
+            os << " " << std::hexfloat << ratio << std::defaultfloat;
+        }
+
+        os << "\n";
+        os << "node " << initData.fallbackNode << "\n";
+
+        for (const auto& m : initData.materials)
+        {
+            os << "material " << m.first << "=" << m.second << "\n";
+        }
+
+        for (const auto& c : initData.clips)
+        {
+            os << "clip " << c.first << "=" << c.second << "\n";
+        }
+
+        return os.str();
+    }
+}
+
+std::string BuildCache::computeKey(const InitData& initData)
+{
+    MappedFile source;
+
+    if (!source.open(initData.fileName))
+    {
+        return "";
+    }
+
+    uint64_t hash = fnv1a64(source.data(), source.size());
+    hash = fnv1a64(describeOptions(initData), hash);
+
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", (unsigned long long)hash);
+
+    return key;
+}
+
+bool BuildCache::lookup(const std::string& key, std::vector<std::string>& fileNames) const
+{
+    std::ifstream list(entryFile(key, LIST_FILE));
+
+    if (!list.is_open())
+    {
+        return false;
+    }
+
+    fileNames.clear();
+    std::string name;
+
+    while (std::getline(list, name))
+    {
+        if (!name.empty())
+        {
+            fileNames.push_back(name);
+        }
+    }
+
+    /*an entry is only valid if all of its files are still there*/
+    std::error_code ec;
+
+    for (const auto& f : fileNames)
+    {
+        if (!fs::is_regular_file(entryFile(key, f), ec))
+        {
+            return false;
+        }
+    }
+
+    /*the key only covers the source, files loaded with it are checked here, "<hash> <path>" per line*/
+    std::ifstream inputs(entryFile(key, INPUT_FILE));
+
+    if (!inputs.is_open())
+    {
+        return false;
+    }
+
+    std::string line;
+
+    while (std::getline(inputs, line))
+    {
+        size_t separator = line.find(' ');
+        uint64_t hash = 0;
+
+        if (separator == std::string::npos)
+        {
+            continue;
+        }
+
+        if (!hashFile(line.substr(separator + 1), hash) || strtoull(line.substr(0, separator).c_str(), nullptr, 16) != hash)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::string BuildCache::entryFile(const std::string& key, const std::string& fileName) const
+{
+    return (fs::path(directory) / key / fileName).string();
+}
+
+bool BuildCache::store(const std::string& key, const std::vector<std::string>& outputFiles, const std::vector<std::string>& inputFiles) const
+{
+    std::error_code ec;
+    fs::path entry = fs::path(directory) / key;
+
+    if (fs::exists(entry, ec))
+    {
+        std::vector<std::string> fileNames;
+
+        if (lookup(key, fileNames))
+        {
+            return true;
+        }
+
+        /*stale, an input changed after the entry was stored*/
+        fs::remove_all(entry, ec);
+    }
+
+    /*fill a private directory first so readers never see a partial entry*/
+    std::ostringstream tempName;
+    tempName << key << ".tmp" << std::hash<std::thread::id>()(std::this_thread::get_id());
+    fs::path temp = fs::path(directory) / tempName.str();
+
+    fs::remove_all(temp, ec);
+
+    if (!fs::create_directories(temp, ec))
+    {
+        return false;
+    }
+
+    std::ofstream list(temp / LIST_FILE);
+
+    for (const auto& f : outputFiles)
+    {
+        fs::path name = fs::path(f).filename();
+
+        if (!fs::copy_file(f, temp / name, fs::copy_options::overwrite_existing, ec))
+        {
+            list.close();
+            fs::remove_all(temp, ec);
+            return false;
+        }
+
+        list << name.string() << "\n";
+    }
+
+    list.close();
+
+    std::ofstream inputs(temp / INPUT_FILE);
+
+    for (const auto& f : inputFiles)
+    {
+        uint64_t hash = 0;
+
+        if (!hashFile(f, hash))
+        {
+            inputs.close();
+            fs::remove_all(temp, ec);
+            return false;
+        }
+
+        char hex[17];
+        snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+        inputs << hex << " " << fs::absolute(f, ec).string() << "\n";
+    }
+
+    inputs.close();
+
+    fs::rename(temp, entry, ec);
+
+    /*another worker stored the same entry first*/
+    if (ec)
+    {
+        fs::remove_all(temp, ec);
+        return fs::exists(entry, ec);
+    }
+
+    return true;
+}
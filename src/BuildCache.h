@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "data.h"
+
+/*
+Content addressed store of conversion outputs. The key hashes the source
+bytes together with every option that changes the output, each key owns a
+directory with the output files, a list of their names and the hashes of
+all files the importer read, e.g. glTF buffers or OBJ materials:
+
+    <cache>/<key>/outputs.txt
+    <cache>/<key>/inputs.txt
+    <cache>/<key>/hero.s3d
+    <cache>/<key>/hero_walk.clp
+
+An entry whose inputs changed is stale, it is not restored and the next
+store replaces it.
+
+Entries are written to a temporary directory and renamed when complete, so
+several processes or workers can share one cache.
+*/
+class BuildCache
+{
+public:
+    explicit BuildCache(const std::string& directory) : directory(directory) {}
+
+    /*
+    Computes the cache key of a conversion.
+    @returns Key as 16 hex digits, empty if the source can not be read
+    @param Source file and options of the conversion*/
+    static std::string computeKey(const InitData& initData);
+
+    /*
+    Looks up a previous conversion.
+    @returns true if the entry exists and none of its inputs changed
+    @param Cache key
+    @param Names of the output files of the entry*/
+    bool lookup(const std::string& key, std::vector<std::string>& fileNames) const;
+
+    /*
+    Returns the path of a file inside an entry.
+    @param Cache key
+    @param Name of the output file*/
+    std::string entryFile(const std::string& key, const std::string& fileName) const;
+
+    /*
+    Copies the outputs of a successful conversion into the cache.
+    @returns Success status, an existing valid entry counts as success
+    @param Cache key
+    @param Paths of the written output files
+    @param Paths of the files the importer read*/
+    bool store(const std::string& key, const std::vector<std::string>& outputFiles, const std::vector<std::string>& inputFiles) const;
+
+private:
+    std::string directory;
+};
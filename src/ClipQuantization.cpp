@@ -0,0 +1,211 @@
+#include "ClipQuantization.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "KeyFrameReduction.h"
+
+namespace
+{
+    template<typename T>
+    void append(std::vector<char>& buffer, const T& record)
+    {
+        const char* bytes = reinterpret_cast<const char*>(&record);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+
+    /*
+    Writes the ChannelTimingRecord and the key times of a channel, uniform
+    channels store no times.
+    @returns Largest deviation of the decoded times
+    @param Keys of the channel
+    @param Duration of the clip
+    @param Buffer to append to
+    @param Set for uniform channels*/
+    template<typename Key>
+    float encodeTimes(const std::vector<Key>& keys, float duration, std::vector<char>& buffer, bool& uniform)
+    {
+        ChannelTimingRecord timing = { keys.front().timeStamp, (keys.back().timeStamp - keys.front().timeStamp) / (keys.size() - 1) };
+        float maxError = 0.0f;
+
+        /*uniform as long as the computed times are at least as precise as quantized ones*/
+        for (size_t k = 0; k < keys.size(); k++)
+        {
+            maxError = std::max(maxError, std::fabs(timing.Start + k * timing.Interval - keys[k].timeStamp));
+        }
+
+        uniform = timing.Interval > 0.0f && maxError <= duration / 131070.0f;
+
+        if (uniform)
+        {
+            append(buffer, timing);
+            return maxError;
+        }
+
+        timing.Interval = 0.0f;
+        append(buffer, timing);
+        maxError = 0.0f;
+
+        for (const auto& key : keys)
+        {
+            uint16_t time = encodeUnorm16(duration > 0.0f ? key.timeStamp / duration : 0.0f);
+            append(buffer, time);
+            maxError = std::max(maxError, std::fabs(unpackTime(time, duration) - key.timeStamp));
+        }
+
+        return maxError;
+    }
+
+    /*
+    Writes a translation or scale channel.
+    @returns Largest distance of a decoded value from its key
+    @param Keys of the channel
+    @param Duration of the clip
+    @param Buffer to append to
+    @param Statistics of the bone*/
+    float encodeVectors(const std::vector<VectorKey>& keys, float duration, std::vector<char>& buffer, ClipQuantizationStats& stats)
+    {
+        if (keys.size() == 1)
+        {
+            append(buffer, VectorRecord{ { keys[0].value.x, keys[0].value.y, keys[0].value.z } });
+            return 0.0f;
+        }
+
+        bool uniform = false;
+        stats.maxTimeError = std::max(stats.maxTimeError, encodeTimes(keys, duration, buffer, uniform));
+        stats.channels++;
+        stats.uniformChannels += uniform;
+
+        aiVector3D vMin = keys[0].value;
+        aiVector3D vMax = keys[0].value;
+
+        for (const auto& key : keys)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                vMin[k] = std::min(vMin[k], key.value[k]);
+                vMax[k] = std::max(vMax[k], key.value[k]);
+            }
+        }
+
+        ChannelRangeRecord range;
+
+        for (int k = 0; k < 3; k++)
+        {
+            range.Offset[k] = vMin[k];
+            range.Scale[k] = (vMax[k] - vMin[k]) / 65535.0f;
+        }
+
+        append(buffer, range);
+
+        float maxError = 0.0f;
+
+        for (const auto& key : keys)
+        {
+            QuantizedVectorRecord r;
+
+            for (int k = 0; k < 3; k++)
+            {
+                r.Value[k] = range.Scale[k] > 0.0f ? encodeUnorm16((key.value[k] - range.Offset[k]) / (range.Scale[k] * 65535.0f)) : 0;
+            }
+
+            append(buffer, r);
+
+            VectorRecord decoded;
+            unpackKey(r, &range, decoded);
+            maxError = std::max(maxError, (aiVector3D(decoded.Value[0], decoded.Value[1], decoded.Value[2]) - key.value).Length());
+        }
+
+        return maxError;
+    }
+
+    /*
+    Writes a rotation channel.
+    @returns Largest angle between a decoded rotation and its key in degrees
+    @param Keys of the channel
+    @param Duration of the clip
+    @param Buffer to append to
+    @param Statistics of the bone*/
+    float encodeRotations(const std::vector<RotationKey>& keys, float duration, std::vector<char>& buffer, ClipQuantizationStats& stats)
+    {
+        if (keys.size() == 1)
+        {
+            append(buffer, QuaternionRecord{ { keys[0].value.x, keys[0].value.y, keys[0].value.z, keys[0].value.w } });
+            return 0.0f;
+        }
+
+        bool uniform = false;
+        stats.maxTimeError = std::max(stats.maxTimeError, encodeTimes(keys, duration, buffer, uniform));
+        stats.channels++;
+        stats.uniformChannels += uniform;
+
+        float maxError = 0.0f;
+
+        for (const auto& key : keys)
+        {
+            aiQuaternion q = key.value;
+            q.Normalize();
+
+            float value[4] = { q.x, q.y, q.z, q.w };
+            QuantizedQuaternionRecord r;
+            encodeQuaternion(value, r.Value);
+            append(buffer, r);
+
+            QuaternionRecord decoded;
+            unpackKey(r, nullptr, decoded);
+
+            maxError = std::max(maxError, rotationAngle(aiQuaternion(decoded.Value[3], decoded.Value[0], decoded.Value[1], decoded.Value[2]), q));
+        }
+
+        return maxError;
+    }
+}
+
+void ClipQuantizationStats::add(const ClipQuantizationStats& other)
+{
+    channels += other.channels;
+    uniformChannels += other.uniformChannels;
+    maxTranslationError = std::max(maxTranslationError, other.maxTranslationError);
+    maxRotationError = std::max(maxRotationError, other.maxRotationError);
+    maxScaleError = std::max(maxScaleError, other.maxScaleError);
+    maxTimeError = std::max(maxTimeError, other.maxTimeError);
+}
+
+float clipDuration(const std::vector<BoneChannels>& channels)
+{
+    float duration = 0.0f;
+
+    for (const auto& c : channels)
+    {
+        if (!c.translation.empty()) duration = std::max(duration, c.translation.back().timeStamp);
+        if (!c.rotation.empty()) duration = std::max(duration, c.rotation.back().timeStamp);
+        if (!c.scale.empty()) duration = std::max(duration, c.scale.back().timeStamp);
+    }
+
+    return duration;
+}
+
+ClipQuantizationStats encodeChannels(const BoneChannels& channels, float duration, std::vector<char>& buffer)
+{
+    ClipQuantizationStats stats;
+    ChannelCountsRecord counts = { (UINT)channels.translation.size(), (UINT)channels.rotation.size(), (UINT)channels.scale.size() };
+
+    append(buffer, counts);
+
+    if (!channels.translation.empty())
+    {
+        stats.maxTranslationError = encodeVectors(channels.translation, duration, buffer, stats);
+    }
+
+    if (!channels.rotation.empty())
+    {
+        stats.maxRotationError = encodeRotations(channels.rotation, duration, buffer, stats);
+    }
+
+    if (!channels.scale.empty())
+    {
+        stats.maxScaleError = encodeVectors(channels.scale, duration, buffer, stats);
+    }
+
+    return stats;
+}
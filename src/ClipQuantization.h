@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+
+#include "Format.h"
+#include "data.h"
+
+/*largest deviations of decoded keys from the source keys*/
+struct ClipQuantizationStats
+{
+    size_t channels = 0; /*channels with more than one key*/
+    size_t uniformChannels = 0;
+    float maxTranslationError = 0.0f;
+    float maxRotationError = 0.0f; /*degrees*/
+    float maxScaleError = 0.0f;
+    float maxTimeError = 0.0f; /*seconds*/
+
+    void add(const ClipQuantizationStats& other);
+};
+
+/*
+Duration of a clip as stored in quantized clips.
+@returns Largest key time of all channels
+@param Channels of all bones*/
+float clipDuration(const std::vector<BoneChannels>& channels);
+
+/*
+Encodes the channels of a bone in the quantized channel layout, starting
+with the ChannelCountsRecord. Translation and scale are quantized to 16 bits
+over the range of the channel, rotations use the smallest three encoding.
+@returns Deviations of the decoded keys from the channels
+@param Channels of a single bone, sorted by time
+@param Duration of the clip, see clipDuration
+@param Buffer the records are appended to*/
+ClipQuantizationStats encodeChannels(const BoneChannels& channels, float duration, std::vector<char>& buffer);
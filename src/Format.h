@@ -0,0 +1,450 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Meshlets.h"
+#include "Quantize.h"
+#include "data.h"
+
+/*
+On-disk record layouts shared by the writer and the readers of the
+B3D, S3D and CLP formats and of packs. All records are tightly packed and
+little endian.
+*/
+
+const char B3D_MAGIC[4] = { 'b', '3', 'd', 'f' };
+const char S3D_MAGIC[4] = { 's', '3', 'd', 'f' };
+const char CLP_MAGIC[4] = { 'c', 'l', 'p', 'f' };
+
+/*
+Extended B3D/S3D files start with their own magic followed by a version
+and flags describing the encoding, the rest of the layout matches the
+plain format except where a flag changes it.
+*/
+const char B3D_EXTENDED_MAGIC[4] = { 'b', '3', 'd', 'x' };
+const char S3D_EXTENDED_MAGIC[4] = { 's', '3', 'd', 'x' };
+const UINT EXTENDED_FORMAT_VERSION = 1;
+
+/*
+Version 2 B3D/S3D files follow the header with a UINT section count and
+the SectionRecords, every section can be located without parsing the ones
+in front of it. Sections keep the layout of the matching part of version 1
+except that all counts, bone ids and name lengths are UINTs:
+SECTION_BONES holds the bone count and the bones, SECTION_BONE_HIERARCHY
+the pair count and BoneHierarchyRecords, SECTION_NODES the node tree and
+SECTION_MESHES the mesh count and the meshes and SECTION_MESH_INDEX the
+mesh count and a MeshIndexRecord per mesh. Static models only have the
+mesh sections, readers skip sections they do not know.
+*/
+const UINT SECTIONED_FORMAT_VERSION = 2;
+
+const UINT SECTION_BONES = 1;
+const UINT SECTION_BONE_HIERARCHY = 2;
+const UINT SECTION_NODES = 3;
+const UINT SECTION_MESHES = 4;
+const UINT SECTION_MESH_INDEX = 5;
+
+/*limits of the plain format and version 1, counts and bone ids are single bytes*/
+const size_t PLAIN_FORMAT_MAX_MESHES = 255;
+const size_t PLAIN_FORMAT_MAX_BONES = 255;
+
+/*vertices use the quantized records, every mesh starts with a QuantizationRecord*/
+const UINT FORMAT_QUANTIZED = 1 << 0;
+
+/*every mesh stores the byte width of its indices (2 or 4) in front of the index count*/
+const UINT FORMAT_INDEX_WIDTH = 1 << 1;
+
+/*every mesh is followed by its meshlets, see MeshletRecord*/
+const UINT FORMAT_MESHLETS = 1 << 2;
+
+/*every mesh starts with its bone palette, a UINT count and the bones of the palette slots, blend indices are slots*/
+const UINT FORMAT_BONE_PALETTES = 1 << 3;
+
+/*extended CLP files use the same header as extended B3D/S3D files*/
+const char CLP_EXTENDED_MAGIC[4] = { 'c', 'l', 'p', 'x' };
+
+/*bones store translation, rotation and scale as separate channels, see ChannelCountsRecord*/
+const UINT CLIP_CHANNELS = 1 << 0;
+
+/*
+Channels are quantized, only together with CLIP_CHANNELS. The bone count is
+followed by the clip duration, channels with more than one key start with a
+ChannelTimingRecord, see there.
+*/
+const UINT CLIP_QUANTIZED = 1 << 1;
+
+/*
+Pack of converted files: the magic, a PackHeaderRecord, the
+PackEntryRecords sorted by NameHash, the names of all entries and the entry
+data. The data of every entry starts at a multiple of the alignment, stored
+entries can be used in place from a mapping of the pack.
+*/
+const char PACK_MAGIC[4] = { 'p', 'a', 'k', 'f' };
+const UINT PACK_FORMAT_VERSION = 1;
+
+/*compression of a pack entry*/
+const UINT PACK_STORED = 0;
+const UINT PACK_LZ4 = 1; /*a single LZ4 block, see LZ4.h*/
+
+#pragma pack(push, 1)
+
+/*4x4 matrix, stored transposed relative to aiMatrix4x4*/
+struct MatrixRecord
+{
+    float m[16];
+};
+
+/*bone and its parent bone, -1 for the root*/
+struct BoneHierarchyRecord
+{
+    int Bone;
+    int Parent;
+};
+
+/*vertex of a static mesh (b3d)*/
+struct StaticVertexRecord
+{
+    float Position[3];
+    float Texture[2];
+    float Normal[3];
+    float TangentU[3];
+};
+
+/*single bone influence of a skinned vertex*/
+struct InfluenceRecord
+{
+    UINT Index;
+    float Weight;
+};
+
+/*vertex of a skinned mesh (s3d)*/
+struct SkinnedVertexRecord
+{
+    StaticVertexRecord Base;
+    InfluenceRecord Influences[MAX_BONE_INFLUENCES];
+};
+
+/*header of the extended format after the magic*/
+struct ExtendedHeaderRecord
+{
+    UINT Version;
+    UINT Flags;
+};
+
+/*location of a section, the offset is relative to the start of the file*/
+struct SectionRecord
+{
+    UINT Type;
+    uint64_t Offset;
+    uint64_t Size;
+};
+
+/*location of a single mesh inside SECTION_MESHES, relative to the start of the file*/
+struct MeshIndexRecord
+{
+    uint64_t Offset;
+    uint64_t Size;
+};
+
+struct PackHeaderRecord
+{
+    UINT Version;
+    UINT EntryCount;
+    UINT Alignment; /*power of two*/
+    UINT NamesSize;
+};
+
+/*file of a pack, names are paths relative to the packed directory with / as separator*/
+struct PackEntryRecord
+{
+    uint64_t NameHash; /*fnv1a64 of the name*/
+    uint64_t Offset; /*relative to the start of the pack*/
+    uint64_t StoredSize;
+    uint64_t Size; /*after decompression*/
+    UINT NameOffset; /*first character in the names*/
+    UINT NameLength;
+    UINT Compression;
+};
+
+/*maps quantized positions back to model space: p = Offset + q * Scale*/
+struct QuantizationRecord
+{
+    float PositionOffset[3];
+    float PositionScale[3];
+};
+
+/*
+Quantized vertex of a static mesh: unorm16 positions relative to the mesh
+bounds (fourth component unused), half float UVs, octahedral snorm16
+normal and tangent.
+*/
+struct QuantizedStaticVertexRecord
+{
+    uint16_t Position[4];
+    uint16_t Texture[2];
+    int16_t Normal[2];
+    int16_t TangentU[2];
+};
+
+/*quantized vertex of a skinned mesh, weights are unorm8 and sum to 255*/
+struct QuantizedSkinnedVertexRecord
+{
+    QuantizedStaticVertexRecord Base;
+    uint8_t BlendIndices[MAX_BONE_INFLUENCES];
+    uint8_t BlendWeights[MAX_BONE_INFLUENCES];
+};
+
+/*
+Meshlet of a mesh. The meshlet section of a mesh is the meshlet count and
+records, the count and mesh vertex indices of all meshlet vertices and the
+count and local vertex indices of all meshlet triangles (three bytes each).
+*/
+struct MeshletRecord
+{
+    UINT VertexOffset;
+    UINT TriangleOffset; /*first local index, three per triangle*/
+    BYTE VertexCount;
+    BYTE TriangleCount;
+    float Center[3];
+    float Radius;
+    float ConeApex[3];
+    float ConeAxis[3];
+    float ConeCutoff;
+};
+
+/*key frame of a bone in an animation clip (clp)*/
+struct KeyFrameRecord
+{
+    float TimeStamp;
+    float Translation[3];
+    float Scale[3];
+    float RotationQuat[4];
+};
+
+/*
+Key counts of the channels of a bone in a channel clip, all zero for bones
+without animation. Every channel stores its key times followed by its
+values, a channel with a single key is constant.
+*/
+struct ChannelCountsRecord
+{
+    UINT Translation;
+    UINT Rotation;
+    UINT Scale;
+};
+
+struct VectorRecord
+{
+    float Value[3];
+};
+
+/*x, y, z, w like KeyFrameRecord*/
+struct QuaternionRecord
+{
+    float Value[4];
+};
+
+/*
+Key times of a quantized channel. Keys of uniform channels are Interval
+apart starting at Start and store no times, for Interval 0 the channel
+stores a unorm16 time per key relative to the clip duration. The times are
+followed by a ChannelRangeRecord and QuantizedVectorRecords for translation
+and scale or by QuantizedQuaternionRecords for rotation. Quantized channels
+with a single key store no time and the full precision value.
+*/
+struct ChannelTimingRecord
+{
+    float Start;
+    float Interval;
+};
+
+/*maps quantized channel values back: v = Offset + q * Scale*/
+struct ChannelRangeRecord
+{
+    float Offset[3];
+    float Scale[3];
+};
+
+struct QuantizedVectorRecord
+{
+    uint16_t Value[3];
+};
+
+/*smallest three encoding, see encodeQuaternion*/
+struct QuantizedQuaternionRecord
+{
+    uint16_t Value[3];
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(MatrixRecord) == sizeof(aiMatrix4x4), "unexpected matrix size");
+static_assert(sizeof(StaticVertexRecord) == 11 * sizeof(float), "unexpected b3d vertex size");
+static_assert(sizeof(SkinnedVertexRecord) == sizeof(StaticVertexRecord) + MAX_BONE_INFLUENCES * 8, "unexpected s3d vertex size");
+static_assert(sizeof(KeyFrameRecord) == 11 * sizeof(float), "unexpected clp key frame size");
+static_assert(sizeof(MeshletRecord) == 10 + 11 * sizeof(float), "unexpected meshlet size");
+static_assert(sizeof(QuantizedStaticVertexRecord) == 20, "unexpected quantized b3d vertex size");
+static_assert(sizeof(QuantizedSkinnedVertexRecord) == 20 + MAX_BONE_INFLUENCES * 2, "unexpected quantized s3d vertex size");
+static_assert(sizeof(QuantizedQuaternionRecord) == 6, "unexpected quantized rotation size");
+static_assert(sizeof(SectionRecord) == 20, "unexpected section size");
+static_assert(sizeof(MeshIndexRecord) == 16, "unexpected mesh index size");
+static_assert(sizeof(PackEntryRecord) == 44, "unexpected pack entry size");
+
+/*converts a vertex to its static file record*/
+inline void packVertex(const Vertex& v, StaticVertexRecord& r)
+{
+    r.Position[0] = v.Position.x;
+    r.Position[1] = v.Position.y;
+    r.Position[2] = v.Position.z;
+    r.Texture[0] = v.Texture.x;
+    r.Texture[1] = v.Texture.y;
+    r.Normal[0] = v.Normal.x;
+    r.Normal[1] = v.Normal.y;
+    r.Normal[2] = v.Normal.z;
+    r.TangentU[0] = v.TangentU.x;
+    r.TangentU[1] = v.TangentU.y;
+    r.TangentU[2] = v.TangentU.z;
+}
+
+/*converts a vertex to its skinned file record, unused influence slots are zero*/
+inline void packVertex(const Vertex& v, SkinnedVertexRecord& r)
+{
+    packVertex(v, r.Base);
+
+    for (int k = 0; k < MAX_BONE_INFLUENCES; k++)
+    {
+        r.Influences[k].Index = v.BlendIndices[k];
+        r.Influences[k].Weight = v.BlendWeights[k];
+    }
+}
+
+/*
+Computes the position quantization of a mesh from its bounds.
+@returns Offset and scale of the mesh
+@param Vertices of the mesh*/
+inline QuantizationRecord computeQuantization(const std::vector<Vertex>& vertices)
+{
+    QuantizationRecord q = {};
+
+    if (vertices.empty())
+    {
+        return q;
+    }
+
+    aiVector3D vMin = vertices[0].Position;
+    aiVector3D vMax = vertices[0].Position;
+
+    for (const auto& v : vertices)
+    {
+        vMin.x = std::min(vMin.x, v.Position.x);
+        vMin.y = std::min(vMin.y, v.Position.y);
+        vMin.z = std::min(vMin.z, v.Position.z);
+        vMax.x = std::max(vMax.x, v.Position.x);
+        vMax.y = std::max(vMax.y, v.Position.y);
+        vMax.z = std::max(vMax.z, v.Position.z);
+    }
+
+    for (int k = 0; k < 3; k++)
+    {
+        q.PositionOffset[k] = vMin[k];
+        q.PositionScale[k] = (vMax[k] - vMin[k]) / 65535.0f;
+    }
+
+    return q;
+}
+
+/*
+Converts a meshlet to its file record.
+@param Meshlet
+@param Added to the radius, covers the position quantization error
+@param File record*/
+inline void packMeshlet(const Meshlet& m, float padding, MeshletRecord& r)
+{
+    r.VertexOffset = m.vertexOffset;
+    r.TriangleOffset = m.triangleOffset;
+    r.VertexCount = (BYTE)m.vertexCount;
+    r.TriangleCount = (BYTE)m.triangleCount;
+    r.Radius = m.radius + padding;
+    r.ConeCutoff = m.coneCutoff;
+
+    for (int k = 0; k < 3; k++)
+    {
+        r.Center[k] = m.center[k];
+        r.ConeApex[k] = m.coneApex[k];
+        r.ConeAxis[k] = m.coneAxis[k];
+    }
+}
+
+/*converts a vertex to its quantized static file record*/
+inline void packVertex(const Vertex& v, const QuantizationRecord& q, QuantizedStaticVertexRecord& r)
+{
+    for (int k = 0; k < 3; k++)
+    {
+        r.Position[k] = q.PositionScale[k] > 0.0f ? encodeUnorm16((v.Position[k] - q.PositionOffset[k]) / (q.PositionScale[k] * 65535.0f)) : 0;
+    }
+
+    r.Position[3] = 0;
+    r.Texture[0] = encodeHalf(v.Texture.x);
+    r.Texture[1] = encodeHalf(v.Texture.y);
+    encodeOctahedral(v.Normal.x, v.Normal.y, v.Normal.z, r.Normal);
+    encodeOctahedral(v.TangentU.x, v.TangentU.y, v.TangentU.z, r.TangentU);
+}
+
+/*converts a vertex to its quantized skinned file record, bone indices must be below 256*/
+inline void packVertex(const Vertex& v, const QuantizationRecord& q, QuantizedSkinnedVertexRecord& r)
+{
+    packVertex(v, q, r.Base);
+
+    for (int k = 0; k < MAX_BONE_INFLUENCES; k++)
+    {
+        r.BlendIndices[k] = (uint8_t)v.BlendIndices[k];
+    }
+
+    encodeWeights(v.BlendWeights, r.BlendWeights, MAX_BONE_INFLUENCES);
+}
+
+/*converts a quantized record back to the plain record*/
+inline void unpackVertex(const QuantizedStaticVertexRecord& r, const QuantizationRecord& q, StaticVertexRecord& result)
+{
+    for (int k = 0; k < 3; k++)
+    {
+        result.Position[k] = q.PositionOffset[k] + r.Position[k] * q.PositionScale[k];
+    }
+
+    result.Texture[0] = decodeHalf(r.Texture[0]);
+    result.Texture[1] = decodeHalf(r.Texture[1]);
+    decodeOctahedral(r.Normal, result.Normal);
+    decodeOctahedral(r.TangentU, result.TangentU);
+}
+
+inline void unpackVertex(const QuantizedSkinnedVertexRecord& r, const QuantizationRecord& q, SkinnedVertexRecord& result)
+{
+    unpackVertex(r.Base, q, result.Base);
+
+    for (int k = 0; k < MAX_BONE_INFLUENCES; k++)
+    {
+        result.Influences[k].Index = r.BlendIndices[k];
+        result.Influences[k].Weight = decodeWeight(r.BlendWeights[k]);
+    }
+}
+
+/*time of a quantized key*/
+inline float unpackTime(uint16_t time, float duration)
+{
+    return decodeUnorm16(time) * duration;
+}
+
+/*converts a quantized translation or scale back to the plain record*/
+inline void unpackKey(const QuantizedVectorRecord& r, const ChannelRangeRecord* range, VectorRecord& result)
+{
+    for (int k = 0; k < 3; k++)
+    {
+        result.Value[k] = range->Offset[k] + r.Value[k] * range->Scale[k];
+    }
+}
+
+/*converts a quantized rotation back to the plain record, rotations need no range*/
+inline void unpackKey(const QuantizedQuaternionRecord& r, const ChannelRangeRecord*, QuaternionRecord& result)
+{
+    decodeQuaternion(r.Value, result.Value);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+/*
+64 bit FNV-1a hash, pass the previous result as seed to hash data in pieces.
+@returns Hash of the bytes
+@param Data to hash
+@param Size in bytes
+@param Seed or previous hash*/
+inline uint64_t fnv1a64(const void* data, size_t size, uint64_t seed = FNV_OFFSET_BASIS)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+inline uint64_t fnv1a64(const std::string& str, uint64_t seed = FNV_OFFSET_BASIS)
+{
+    return fnv1a64(str.data(), str.size(), seed);
+}
@@ -0,0 +1,338 @@
+#include "KeyFrameReduction.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+namespace
+{
+    const float RADIANS_TO_DEGREES = 57.2957795f;
+
+    /*deviations of a key from the sampled value*/
+    struct KeyError
+    {
+        float translation = 0.0f;
+        float rotation = 0.0f;
+        float scale = 0.0f;
+
+        bool within(const KeyFrameTolerance& tolerance) const
+        {
+            return translation <= tolerance.translation && rotation <= tolerance.rotation && scale <= tolerance.scale;
+        }
+    };
+
+    KeyError compare(const KeyFrame& key, const aiVector3D& translation, const aiQuaternion& rotation, const aiVector3D& scale)
+    {
+        KeyError error;
+
+        error.translation = (key.translation - translation).Length();
+        error.rotation = rotationAngle(key.rotationQuat, rotation);
+        error.scale = (key.scale - scale).Length();
+
+        return error;
+    }
+
+    /*deviation of a key from the interpolation between two other keys*/
+    KeyError interpolationError(const KeyFrame& first, const KeyFrame& last, const KeyFrame& key)
+    {
+        float duration = last.timeStamp - first.timeStamp;
+        float factor = duration > 0.0f ? std::min(std::max((key.timeStamp - first.timeStamp) / duration, 0.0f), 1.0f) : 0.0f;
+
+        aiQuaternion rotation;
+        aiQuaternion::Interpolate(rotation, first.rotationQuat, last.rotationQuat, factor);
+        rotation.Normalize();
+
+        return compare(key,
+            first.translation + (last.translation - first.translation) * factor,
+            rotation,
+            first.scale + (last.scale - first.scale) * factor);
+    }
+
+    /*equal values are exact even where the distance has rounding errors*/
+    template<typename T, typename Distance>
+    float deviation(const T& a, const T& b, Distance distance)
+    {
+        return a == b ? 0.0f : distance(a, b);
+    }
+
+    /*
+    Collapses a channel to its first key if all keys match it.
+    @returns true if the channel was collapsed
+    @param Keys with timeStamp and value
+    @param Largest allowed deviation
+    @param Deviation of two values
+    @param Largest deviation from the first key if collapsed*/
+    template<typename Key, typename Distance>
+    bool collapseChannel(std::vector<Key>& keys, float tolerance, Distance distance, float& maxError)
+    {
+        float error = 0.0f;
+
+        for (size_t k = 1; k < keys.size(); k++)
+        {
+            error = std::max(error, deviation(keys[k].value, keys[0].value, distance));
+
+            if (error > tolerance)
+            {
+                return false;
+            }
+        }
+
+        keys.resize(std::min(keys.size(), (size_t)1));
+        maxError = error;
+
+        return true;
+    }
+
+    /*
+    Greedy reduction of a single channel, see reduceKeyFrames.
+    @returns Largest deviation at the dropped keys
+    @param Keys with timeStamp and value, reduced in place
+    @param Largest allowed deviation
+    @param Interpolation of two values
+    @param Deviation of two values*/
+    template<typename Key, typename Lerp, typename Distance>
+    float reduceChannel(std::vector<Key>& keys, float tolerance, Lerp lerp, Distance distance)
+    {
+        float maxError = 0.0f;
+
+        if (collapseChannel(keys, tolerance, distance, maxError))
+        {
+            return maxError;
+        }
+
+        std::vector<Key> result = { keys[0] };
+        size_t anchor = 0;
+
+        while (anchor + 1 < keys.size())
+        {
+            size_t end = anchor + 1;
+            float segmentError = 0.0f;
+
+            while (end + 1 < keys.size())
+            {
+                const Key& first = keys[anchor];
+                const Key& last = keys[end + 1];
+                float duration = last.timeStamp - first.timeStamp;
+                float candidateError = 0.0f;
+
+                for (size_t k = anchor + 1; k <= end && candidateError <= tolerance; k++)
+                {
+                    float factor = duration > 0.0f ? std::min(std::max((keys[k].timeStamp - first.timeStamp) / duration, 0.0f), 1.0f) : 0.0f;
+                    candidateError = std::max(candidateError, deviation(keys[k].value, lerp(first.value, last.value, factor), distance));
+                }
+
+                if (candidateError > tolerance)
+                {
+                    break;
+                }
+
+                segmentError = candidateError;
+                end++;
+            }
+
+            result.push_back(keys[end]);
+            maxError = std::max(maxError, segmentError);
+            anchor = end;
+        }
+
+        keys = std::move(result);
+
+        return maxError;
+    }
+
+    aiVector3D lerpVector(const aiVector3D& a, const aiVector3D& b, float factor)
+    {
+        return a + (b - a) * factor;
+    }
+
+    float vectorDistance(const aiVector3D& a, const aiVector3D& b)
+    {
+        return (a - b).Length();
+    }
+
+    aiQuaternion slerpRotation(const aiQuaternion& a, const aiQuaternion& b, float factor)
+    {
+        aiQuaternion result;
+        aiQuaternion::Interpolate(result, a, b, factor);
+
+        return result.Normalize();
+    }
+
+    void accumulate(KeyFrameReductionStats& stats, const KeyError& error)
+    {
+        stats.maxTranslationError = std::max(stats.maxTranslationError, error.translation);
+        stats.maxRotationError = std::max(stats.maxRotationError, error.rotation);
+        stats.maxScaleError = std::max(stats.maxScaleError, error.scale);
+    }
+}
+
+float rotationAngle(const aiQuaternion& a, const aiQuaternion& b)
+{
+    /*the chord between the quaternions stays precise for small angles where acos of their dot product does not*/
+    float difference = (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z) + (a.w - b.w) * (a.w - b.w);
+    float sum = (a.x + b.x) * (a.x + b.x) + (a.y + b.y) * (a.y + b.y) + (a.z + b.z) * (a.z + b.z) + (a.w + b.w) * (a.w + b.w);
+    float chord = std::sqrt(std::min(difference, sum));
+
+    return 4.0f * std::asin(std::min(chord * 0.5f, 1.0f)) * RADIANS_TO_DEGREES;
+}
+
+void KeyFrameReductionStats::add(const KeyFrameReductionStats& other)
+{
+    keysBefore += other.keysBefore;
+    keysAfter += other.keysAfter;
+    maxTranslationError = std::max(maxTranslationError, other.maxTranslationError);
+    maxRotationError = std::max(maxRotationError, other.maxRotationError);
+    maxScaleError = std::max(maxScaleError, other.maxScaleError);
+}
+
+KeyFrameReductionStats reduceKeyFrames(std::vector<KeyFrame>& track, const KeyFrameTolerance& tolerance)
+{
+    KeyFrameReductionStats stats;
+    std::vector<size_t> keys;
+
+    for (size_t i = 0; i < track.size(); i++)
+    {
+        if (track[i].saveToFile)
+        {
+            keys.push_back(i);
+        }
+    }
+
+    stats.keysBefore = keys.size();
+    stats.keysAfter = keys.size();
+
+    if (keys.size() < 2)
+    {
+        return stats;
+    }
+
+    /*a constant track only needs its first key*/
+    const KeyFrame& first = track[keys[0]];
+    bool constant = true;
+    KeyFrameReductionStats constantStats;
+
+    for (size_t k = 1; k < keys.size() && constant; k++)
+    {
+        KeyError error = compare(track[keys[k]], first.translation, first.rotationQuat, first.scale);
+        constant = error.within(tolerance);
+        accumulate(constantStats, error);
+    }
+
+    if (constant)
+    {
+        for (size_t k = 1; k < keys.size(); k++)
+        {
+            track[keys[k]].saveToFile = false;
+        }
+
+        constantStats.keysBefore = keys.size();
+        constantStats.keysAfter = 1;
+
+        return constantStats;
+    }
+
+    /*greedy: every segment is extended as long as it reproduces all keys it spans*/
+    size_t anchor = 0;
+    stats.keysAfter = 1;
+
+    while (anchor + 1 < keys.size())
+    {
+        size_t end = anchor + 1;
+        KeyFrameReductionStats segmentStats;
+
+        while (end + 1 < keys.size())
+        {
+            KeyFrameReductionStats candidateStats;
+            bool reproduced = true;
+
+            for (size_t k = anchor + 1; k <= end && reproduced; k++)
+            {
+                KeyError error = interpolationError(track[keys[anchor]], track[keys[end + 1]], track[keys[k]]);
+                reproduced = error.within(tolerance);
+                accumulate(candidateStats, error);
+            }
+
+            if (!reproduced)
+            {
+                break;
+            }
+
+            segmentStats = candidateStats;
+            end++;
+        }
+
+        for (size_t k = anchor + 1; k < end; k++)
+        {
+            track[keys[k]].saveToFile = false;
+        }
+
+        stats.add(segmentStats);
+        stats.keysAfter++;
+        anchor = end;
+    }
+
+    return stats;
+}
+
+KeyFrameReductionStats reduceChannels(BoneChannels& channels, const KeyFrameTolerance& tolerance)
+{
+    KeyFrameReductionStats stats;
+
+    stats.keysBefore = channels.translation.size() + channels.rotation.size() + channels.scale.size();
+
+    stats.maxTranslationError = reduceChannel(channels.translation, tolerance.translation, lerpVector, vectorDistance);
+    stats.maxRotationError = reduceChannel(channels.rotation, tolerance.rotation, slerpRotation, rotationAngle);
+    stats.maxScaleError = reduceChannel(channels.scale, tolerance.scale, lerpVector, vectorDistance);
+
+    stats.keysAfter = channels.translation.size() + channels.rotation.size() + channels.scale.size();
+
+    return stats;
+}
+
+KeyFrameReductionStats collapseChannels(BoneChannels& channels, const KeyFrameTolerance& tolerance)
+{
+    KeyFrameReductionStats stats;
+
+    stats.keysBefore = channels.translation.size() + channels.rotation.size() + channels.scale.size();
+
+    collapseChannel(channels.translation, tolerance.translation, vectorDistance, stats.maxTranslationError);
+    collapseChannel(channels.rotation, tolerance.rotation, rotationAngle, stats.maxRotationError);
+    collapseChannel(channels.scale, tolerance.scale, vectorDistance, stats.maxScaleError);
+
+    stats.keysAfter = channels.translation.size() + channels.rotation.size() + channels.scale.size();
+
+    return stats;
+}
+
+bool parseKeyFrameTolerance(const std::string& list, KeyFrameTolerance& tolerance)
+{
+    std::stringstream ss(list);
+    std::string item;
+    float values[3];
+    int count = 0;
+
+    while (std::getline(ss, item, ','))
+    {
+        char* end = nullptr;
+        float value = std::strtof(item.c_str(), &end);
+
+        if (count >= 3 || item.empty() || *end != '\0' || !(value >= 0.0f))
+        {
+            return false;
+        }
+
+        values[count++] = value;
+    }
+
+    if (count != 3)
+    {
+        return false;
+    }
+
+    tolerance.translation = values[0];
+    tolerance.rotation = values[1];
+    tolerance.scale = values[2];
+
+    return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "data.h"
+
+/*key counts and largest deviations of a reduction*/
+struct KeyFrameReductionStats
+{
+    size_t keysBefore = 0;
+    size_t keysAfter = 0;
+    float maxTranslationError = 0.0f;
+    float maxRotationError = 0.0f; /*degrees*/
+    float maxScaleError = 0.0f;
+
+    void add(const KeyFrameReductionStats& other);
+};
+
+/*
+Drops the key frames of a bone track that linear interpolation of the
+translation and scale and slerp of the rotation between the remaining keys
+reproduce within the tolerance. Only keys marked saveToFile are considered,
+dropped keys are unmarked. The first key is always kept, the last one unless
+the whole track is constant.
+@returns Key counts and largest deviations at the dropped keys
+@param Key frames of a single bone, sorted by time
+@param Largest allowed deviations*/
+KeyFrameReductionStats reduceKeyFrames(std::vector<KeyFrame>& track, const KeyFrameTolerance& tolerance);
+
+/*
+Reduces the channels of a bone independently. Channels whose keys all match
+the first key within the tolerance are collapsed to that key, the other
+channels are reduced like reduceKeyFrames. A zero tolerance only drops keys
+that are exact repetitions.
+@returns Key counts of all channels and largest deviations at the dropped keys
+@param Channels of a single bone, sorted by time
+@param Largest allowed deviations*/
+KeyFrameReductionStats reduceChannels(BoneChannels& channels, const KeyFrameTolerance& tolerance);
+
+/*
+Collapses the channels of a bone whose keys all match the first key within
+the tolerance, the other channels keep all keys, e.g. to keep baked
+channels at their fixed rate.
+@returns Key counts of all channels and largest deviations at the dropped keys
+@param Channels of a single bone
+@param Largest allowed deviations*/
+KeyFrameReductionStats collapseChannels(BoneChannels& channels, const KeyFrameTolerance& tolerance);
+
+/*
+Angle between two unit quaternions, q and -q are the same rotation.
+@returns Angle in degrees
+@param First rotation
+@param Second rotation*/
+float rotationAngle(const aiQuaternion& a, const aiQuaternion& b);
+
+/*
+Parses the tolerances "translation,rotation,scale", e.g. "0.001,0.05,0.001".
+@returns false if the list is malformed or a tolerance is negative
+@param List to parse
+@param Parsed tolerances*/
+bool parseKeyFrameTolerance(const std::string& list, KeyFrameTolerance& tolerance);
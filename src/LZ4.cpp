@@ -0,0 +1,204 @@
+#include "LZ4.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+    const size_t MIN_MATCH = 4;
+    const size_t LAST_LITERALS = 5; /*the last bytes of a block are always literals*/
+    const size_t MATCH_FIND_LIMIT = 12; /*the last match starts at least this far before the end*/
+    const size_t MAX_OFFSET = 65535;
+    const int HASH_BITS = 16;
+
+    uint32_t read32(const char* p)
+    {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+
+        return value;
+    }
+
+    size_t hashSequence(uint32_t sequence)
+    {
+        return (sequence * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    /*length beyond the 15 of the token, in bytes of 255 and the remainder*/
+    void writeLength(std::vector<char>& block, size_t length)
+    {
+        for (; length >= 255; length -= 255)
+        {
+            block.push_back((char)255);
+        }
+
+        block.push_back((char)length);
+    }
+
+    bool readLength(const unsigned char*& in, const unsigned char* end, size_t& length)
+    {
+        unsigned char value = 255;
+
+        while (value == 255)
+        {
+            if (in >= end)
+            {
+                return false;
+            }
+
+            value = *in++;
+            length += value;
+        }
+
+        return true;
+    }
+
+    /*literals followed by a match, the last sequence of a block has no match*/
+    void writeSequence(std::vector<char>& block, const char* literals, size_t literalCount, size_t offset, size_t matchLength)
+    {
+        size_t matchCode = matchLength > 0 ? matchLength - MIN_MATCH : 0;
+        block.push_back((char)((std::min(literalCount, (size_t)15) << 4) | std::min(matchCode, (size_t)15)));
+
+        if (literalCount >= 15)
+        {
+            writeLength(block, literalCount - 15);
+        }
+
+        block.insert(block.end(), literals, literals + literalCount);
+
+        if (matchLength > 0)
+        {
+            block.push_back((char)(offset & 0xff));
+            block.push_back((char)(offset >> 8));
+
+            if (matchCode >= 15)
+            {
+                writeLength(block, matchCode - 15);
+            }
+        }
+    }
+}
+
+size_t compressLZ4(const char* data, size_t size, std::vector<char>& block)
+{
+    block.clear();
+    block.reserve(size + size / 255 + 16);
+
+    size_t anchor = 0;
+
+    if (size > MATCH_FIND_LIMIT)
+    {
+        /*last position of every hashed sequence plus one, 0 is empty*/
+        std::vector<uint32_t> table((size_t)1 << HASH_BITS, 0);
+        size_t matchLimit = size - LAST_LITERALS;
+        size_t i = 0;
+
+        while (i + MATCH_FIND_LIMIT < size)
+        {
+            uint32_t sequence = read32(data + i);
+            size_t h = hashSequence(sequence);
+            size_t candidate = table[h];
+            table[h] = (uint32_t)(i + 1);
+
+            if (candidate == 0 || i + 1 - candidate > MAX_OFFSET || read32(data + candidate - 1) != sequence)
+            {
+                i++;
+                continue;
+            }
+
+            size_t match = candidate - 1;
+
+            /*matches also grow backwards over pending literals*/
+            while (i > anchor && match > 0 && data[i - 1] == data[match - 1])
+            {
+                i--;
+                match--;
+            }
+
+            size_t length = MIN_MATCH;
+
+            while (i + length < matchLimit && data[i + length] == data[match + length])
+            {
+                length++;
+            }
+
+            writeSequence(block, data + anchor, i - anchor, i - match, length);
+            i += length;
+            anchor = i;
+        }
+    }
+
+    writeSequence(block, data + anchor, size - anchor, 0, 0);
+
+    return block.size();
+}
+
+bool decompressLZ4(const char* block, size_t blockSize, char* data, size_t size)
+{
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(block);
+    const unsigned char* inEnd = in + blockSize;
+    char* out = data;
+    char* outEnd = data + size;
+
+    while (in < inEnd)
+    {
+        unsigned char token = *in++;
+        size_t literals = token >> 4;
+
+        if ((literals == 15 && !readLength(in, inEnd, literals)) || literals > (size_t)(inEnd - in) || literals > (size_t)(outEnd - out))
+        {
+            return false;
+        }
+
+        memcpy(out, in, literals);
+        in += literals;
+        out += literals;
+
+        /*the last sequence ends after its literals*/
+        if (in == inEnd)
+        {
+            return out == outEnd;
+        }
+
+        if (inEnd - in < 2)
+        {
+            return false;
+        }
+
+        size_t offset = in[0] | ((size_t)in[1] << 8);
+        size_t length = token & 15;
+        in += 2;
+
+        if (offset == 0 || offset > (size_t)(out - data) || (length == 15 && !readLength(in, inEnd, length)))
+        {
+            return false;
+        }
+
+        length += MIN_MATCH;
+
+        if (length > (size_t)(outEnd - out))
+        {
+            return false;
+        }
+
+        /*overlapping matches repeat the bytes just written*/
+        const char* match = out - offset;
+
+        if (offset >= length)
+        {
+            memcpy(out, match, length);
+        }
+        else
+        {
+            for (size_t k = 0; k < length; k++)
+            {
+                out[k] = match[k];
+            }
+        }
+
+        out += length;
+    }
+
+    return false;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/*
+LZ4 block format, compatible with LZ4_compress_default and
+LZ4_decompress_safe. Blocks carry no sizes, the caller stores the
+decompressed size next to the block.
+*/
+
+/*
+Compresses data into a single LZ4 block.
+@returns Size of the block, may be larger than the input for incompressible data
+@param Data to compress
+@param Size in bytes
+@param Compressed block, replaced*/
+size_t compressLZ4(const char* data, size_t size, std::vector<char>& block);
+
+/*
+Decompresses a LZ4 block, malformed blocks are rejected without reading or
+writing out of bounds.
+@returns true if the block decompresses to exactly size bytes
+@param Compressed block
+@param Size of the block in bytes
+@param Destination for the decompressed data
+@param Decompressed size in bytes*/
+bool decompressLZ4(const char* block, size_t blockSize, char* data, size_t size);
@@ -0,0 +1,250 @@
+#include "Manifest.h"
+#include "KeyFrameReduction.h"
+#include "MeshSimplifier.h"
+#include "PostProcess.h"
+
+#include <algorithm>
+#include <fstream>
+
+namespace
+{
+    std::string trim(const std::string& str)
+    {
+        size_t first = str.find_first_not_of(" \t\r\n");
+
+        if (first == std::string::npos)
+        {
+            return "";
+        }
+
+        size_t last = str.find_last_not_of(" \t\r\n");
+
+        return str.substr(first, last - first + 1);
+    }
+
+    std::string normalizePath(std::string path)
+    {
+        std::replace(path.begin(), path.end(), '\\', '/');
+        return path;
+    }
+
+    bool parseBool(const std::string& value, bool& result)
+    {
+        if (value == "1" || value == "on" || value == "yes" || value == "true")
+        {
+            result = true;
+            return true;
+        }
+
+        if (value == "0" || value == "off" || value == "no" || value == "false")
+        {
+            result = false;
+            return true;
+        }
+
+        return false;
+    }
+}
+
+bool Manifest::load(const std::string& fileName)
+{
+    std::ifstream file(fileName);
+
+    if (!file.is_open())
+    {
+        std::cerr << "Can not open manifest " << fileName << "!" << std::endl;
+        return false;
+    }
+
+    sections.clear();
+
+    std::string line;
+    int lineNumber = 0;
+    bool success = true;
+
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+
+        /*strip comments*/
+        size_t comment = line.find('#');
+
+        if (comment != std::string::npos)
+        {
+            line = line.substr(0, comment);
+        }
+
+        line = trim(line);
+
+        if (line.empty())
+        {
+            continue;
+        }
+
+        if (line.front() == '[' && line.back() == ']')
+        {
+            sections.push_back(std::make_pair(normalizePath(trim(line.substr(1, line.size() - 2))), Options()));
+            continue;
+        }
+
+        size_t eq = line.find('=');
+
+        if (eq == std::string::npos || sections.empty())
+        {
+            std::cerr << fileName << "(" << lineNumber << "): Expected a [section] or key = value!" << std::endl;
+            success = false;
+            continue;
+        }
+
+        std::string key = trim(line.substr(0, eq));
+        std::string value = trim(line.substr(eq + 1));
+
+        /*check the option once while loading so errors show up before converting*/
+        InitData test;
+
+        if (!applyOption(test, key, value))
+        {
+            std::cerr << fileName << "(" << lineNumber << "): Invalid option " << key << " = " << value << "!" << std::endl;
+            success = false;
+            continue;
+        }
+
+        sections.back().second.push_back(std::make_pair(key, value));
+    }
+
+    return success;
+}
+
+void Manifest::apply(const std::string& relativePath, InitData& initData) const
+{
+    std::string path = normalizePath(relativePath);
+    std::string name = path.substr(path.find_last_of('/') + 1);
+
+    for (const auto& s : sections)
+    {
+        if (s.first != "*" && s.first != path && s.first != name)
+        {
+            continue;
+        }
+
+        for (const auto& o : s.second)
+        {
+            applyOption(initData, o.first, o.second);
+        }
+    }
+}
+
+bool Manifest::applyOption(InitData& initData, const std::string& key, const std::string& value)
+{
+    bool flag = false;
+
+    if (key == "scale")
+    {
+        initData.scaleFactor = (float)atof(value.c_str());
+        return initData.scaleFactor > 0.0f;
+    }
+    else if (key == "center")
+    {
+        if (!parseBool(value, flag)) return false;
+        initData.centerEnabled = flag ? 1 : 0;
+    }
+    else if (key == "prefix")
+    {
+        initData.prefix = value;
+    }
+    else if (key == "static")
+    {
+        if (!parseBool(value, flag)) return false;
+        initData.forceStatic = flag;
+    }
+    else if (key == "transform")
+    {
+        if (!parseBool(value, flag)) return false;
+        initData.forceTransform = flag;
+    }
+    else if (key == "pp")
+    {
+        unsigned int flags = 0;
+        if (!getPostProcessPreset(value, flags)) return false;
+        initData.postProcess = value;
+    }
+    else if (key == "optimize")
+    {
+        if (!parseBool(value, flag)) return false;
+        initData.optimizeMeshes = flag;
+    }
+    else if (key == "quantize")
+    {
+        if (!parseBool(value, flag)) return false;
+        initData.quantize = flag;
+    }
+    else if (key == "shortindices")
+    {
+        if (!parseBool(value, flag)) return false;
+        initData.shortIndices = flag;
+    }
+    else if (key == "meshlets")
+    {
+        if (!parseBool(value, flag)) return false;
+        initData.meshlets = flag;
+    }
+    else if (key == "channels")
+    {
+        if (!parseBool(value, flag)) return false;
+        initData.channelClips = flag;
+    }
+    else if (key == "quantizeclips")
+    {
+        if (!parseBool(value, flag)) return false;
+        initData.quantizeClips = flag;
+    }
+    else if (key == "palette")
+    {
+        /*largest palette, 0 disables palettes*/
+        int size = atoi(value.c_str());
+
+        if (size != 0 && size < 3 * MAX_BONE_INFLUENCES) return false;
+        initData.bonePaletteSize = (size_t)std::max(size, 0);
+        return size >= 0;
+    }
+    else if (key == "bake")
+    {
+        /*frames per second, 0 keeps the source keys*/
+        initData.bakeRate = (float)atof(value.c_str());
+        return initData.bakeRate >= 0.0f;
+    }
+    else if (key == "keyreduction")
+    {
+        /*on, off or the tolerances*/
+        if (parseBool(value, flag))
+        {
+            initData.reduceKeyFrames = flag;
+            return true;
+        }
+
+        initData.reduceKeyFrames = true;
+        return parseKeyFrameTolerance(value, initData.keyFrameTolerance);
+    }
+    else if (key == "lod")
+    {
+        return parseLodRatios(value, initData.lods);
+    }
+    else if (key == "node")
+    {
+        initData.fallbackNode = value;
+    }
+    else if (key.compare(0, 9, "material.") == 0 && key.size() > 9)
+    {
+        initData.materials[key.substr(9)] = value;
+    }
+    else if (key.compare(0, 5, "clip.") == 0 && key.size() > 5)
+    {
+        initData.clips[key.substr(5)] = value;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
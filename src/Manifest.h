@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "data.h"
+
+/*
+Batch conversion manifest. Plain text file with sections per input file,
+'#' starts a comment:
+
+    [*]
+    scale = 0.01
+    material.* = default
+
+    [characters/hero.fbx]
+    center = 0
+    prefix = HERO_
+    static = 0
+    transform = 1
+    node = Armature
+    pp = preview
+    optimize = 0
+    quantize = 1
+    shortindices = 0
+    lod = 0.5,0.25
+    meshlets = 1
+    keyreduction = 0.001,0.05,0.001
+    channels = 1
+    quantizeclips = 1
+    bake = 30
+    palette = 64
+    material.Body = hero_body
+    material.Helmet = del
+    clip.Armature_Walk = hero_walk 0 10 20
+
+The section [*] applies to every file. Other sections are matched against
+the path relative to the input directory or against the plain file name,
+all matching sections are applied in order. Material and clip values are
+the same answers that would be typed in interactive mode.
+*/
+class Manifest
+{
+public:
+    /*
+    Parses the manifest file.
+    @returns Success status, errors are printed with their line number
+    @param Path to the manifest*/
+    bool load(const std::string& fileName);
+
+    /*
+    Applies all sections matching the file to the init data.
+    @param Path of the input file relative to the input directory
+    @param Init data to modify*/
+    void apply(const std::string& relativePath, InitData& initData) const;
+
+    /*
+    Sets a single option of the init data.
+    @returns false if the key is unknown or the value invalid*/
+    static bool applyOption(InitData& initData, const std::string& key, const std::string& value);
+
+private:
+    typedef std::vector<std::pair<std::string, std::string>> Options;
+
+    std::vector<std::pair<std::string, Options>> sections;
+};
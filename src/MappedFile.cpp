@@ -0,0 +1,157 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& fileName)
+{
+    close();
+
+    HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+
+    if (!GetFileSizeEx(file, &fileSize))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    /*empty files can not be mapped, they are open without data*/
+    if (fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        opened = true;
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    if (mapping == NULL)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (view == NULL)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    mappedData = static_cast<const char*>(view);
+    mappedSize = (size_t)fileSize.QuadPart;
+    opened = true;
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mappedData)
+    {
+        UnmapViewOfFile(mappedData);
+    }
+
+    if (mappingHandle)
+    {
+        CloseHandle(mappingHandle);
+    }
+
+    if (fileHandle)
+    {
+        CloseHandle(fileHandle);
+    }
+
+    mappedData = nullptr;
+    mappedSize = 0;
+    opened = false;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::string& fileName)
+{
+    close();
+
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat fileStat;
+
+    if (fstat(fd, &fileStat) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    /*empty files can not be mapped, they are open without data*/
+    if (fileStat.st_size == 0)
+    {
+        ::close(fd);
+        opened = true;
+        return true;
+    }
+
+    void* view = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    /*the mapping stays valid after the descriptor is closed*/
+    ::close(fd);
+
+    if (view == MAP_FAILED)
+    {
+        return false;
+    }
+
+    mappedData = static_cast<const char*>(view);
+    mappedSize = (size_t)fileStat.st_size;
+    opened = true;
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mappedData)
+    {
+        munmap(const_cast<char*>(mappedData), mappedSize);
+    }
+
+    mappedData = nullptr;
+    mappedSize = 0;
+    opened = false;
+}
+
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+
+/*
+Read-only memory mapping of a whole file. Pages are loaded lazily by the
+operating system when they are first touched. Empty files can not be mapped,
+they open with no data and a size of 0.
+*/
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /*
+    Maps the file into memory, closes a previously opened file.
+    @returns Success status
+    @param Path to the file*/
+    bool open(const std::string& fileName);
+
+    /*unmaps the file*/
+    void close();
+
+    bool isOpen() const { return opened; }
+    const char* data() const { return mappedData; }
+    size_t size() const { return mappedSize; }
+
+private:
+    const char* mappedData = nullptr;
+    size_t mappedSize = 0;
+    bool opened = false;
+
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
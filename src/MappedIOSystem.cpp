@@ -0,0 +1,154 @@
+#include "MappedIOSystem.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+
+namespace
+{
+    std::mutex cacheMutex;
+    std::unordered_map<std::string, std::weak_ptr<const MappedFile>> cache;
+}
+
+size_t MappedIOStream::Read(void* buffer, size_t size, size_t count)
+{
+    if (size == 0 || position >= file->size())
+    {
+        return 0;
+    }
+
+    /*only whole elements are read*/
+    size_t available = std::min(count, (file->size() - position) / size);
+
+    memcpy(buffer, file->data() + position, available * size);
+    position += available * size;
+
+    return available;
+}
+
+size_t MappedIOStream::Write(const void*, size_t, size_t)
+{
+    return 0;
+}
+
+aiReturn MappedIOStream::Seek(size_t offset, aiOrigin origin)
+{
+    size_t target = 0;
+
+    switch (origin)
+    {
+    case aiOrigin_SET:
+        target = offset;
+        break;
+    case aiOrigin_CUR:
+        target = position + offset;
+        break;
+    case aiOrigin_END:
+        /*the offset is unsigned, seeking relative to the end can only go backwards*/
+        if (offset > file->size()) return aiReturn_FAILURE;
+        target = file->size() - offset;
+        break;
+    default:
+        return aiReturn_FAILURE;
+    }
+
+    if (target > file->size())
+    {
+        return aiReturn_FAILURE;
+    }
+
+    position = target;
+
+    return aiReturn_SUCCESS;
+}
+
+size_t MappedIOStream::Tell() const
+{
+    return position;
+}
+
+size_t MappedIOStream::FileSize() const
+{
+    return file->size();
+}
+
+void MappedIOStream::Flush()
+{
+}
+
+bool MappedIOSystem::Exists(const char* file) const
+{
+    std::error_code ec;
+    return std::filesystem::is_regular_file(file, ec);
+}
+
+char MappedIOSystem::getOsSeparator() const
+{
+#ifdef _WIN32
+    return '\\';
+#else
+    return '/';
+#endif
+}
+
+Assimp::IOStream* MappedIOSystem::Open(const char* file, const char* mode)
+{
+    /*importers only read, anything else is refused*/
+    if (strchr(mode, 'w') || strchr(mode, 'a') || strchr(mode, '+'))
+    {
+        return nullptr;
+    }
+
+    std::shared_ptr<const MappedFile> mapped = acquire(file);
+
+    if (!mapped)
+    {
+        return nullptr;
+    }
+
+    if (std::find(openedFiles.begin(), openedFiles.end(), file) == openedFiles.end())
+    {
+        openedFiles.push_back(file);
+    }
+
+    return new MappedIOStream(mapped);
+}
+
+void MappedIOSystem::Close(Assimp::IOStream* stream)
+{
+    delete stream;
+}
+
+std::shared_ptr<const MappedFile> MappedIOSystem::acquire(const std::string& fileName)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    auto it = cache.find(fileName);
+
+    if (it != cache.end())
+    {
+        if (auto mapped = it->second.lock())
+        {
+            return mapped;
+        }
+    }
+
+    auto mapped = std::make_shared<MappedFile>();
+
+    if (!mapped->open(fileName))
+    {
+        return nullptr;
+    }
+
+    /*drop entries of files that are no longer mapped*/
+    for (auto e = cache.begin(); e != cache.end();)
+    {
+        e = e->second.expired() ? cache.erase(e) : std::next(e);
+    }
+
+    cache[fileName] = mapped;
+
+    return mapped;
+}
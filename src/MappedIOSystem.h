@@ -0,0 +1,59 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <assimp\IOStream.hpp>
+#include <assimp\IOSystem.hpp>
+
+#include "MappedFile.h"
+
+/*
+Read-only Assimp stream over a memory mapped file. Reads are plain copies
+out of the mapping, the operating system pages the file in on demand.
+*/
+class MappedIOStream : public Assimp::IOStream
+{
+public:
+    explicit MappedIOStream(std::shared_ptr<const MappedFile> file) : file(std::move(file)) {}
+
+    size_t Read(void* buffer, size_t size, size_t count) override;
+    size_t Write(const void* buffer, size_t size, size_t count) override;
+    aiReturn Seek(size_t offset, aiOrigin origin) override;
+    size_t Tell() const override;
+    size_t FileSize() const override;
+    void Flush() override;
+
+private:
+    std::shared_ptr<const MappedFile> file;
+    size_t position = 0;
+};
+
+/*
+Assimp file system that opens every file through a memory mapping. Mappings
+are shared between all importers of the process, a file opened by several
+workers at the same time is mapped once and unmapped when the last stream
+is closed. Empty files open as empty streams like with the default IOSystem.
+The importer takes ownership when passed to SetIOHandler().
+*/
+class MappedIOSystem : public Assimp::IOSystem
+{
+public:
+    bool Exists(const char* file) const override;
+    char getOsSeparator() const override;
+    Assimp::IOStream* Open(const char* file, const char* mode = "rb") override;
+    void Close(Assimp::IOStream* stream) override;
+
+    /*files opened so far, the source and everything the importer loaded with it*/
+    const std::vector<std::string>& getOpenedFiles() const { return openedFiles; }
+
+    /*
+    Returns the mapping of a file, maps it if no other stream uses it.
+    @returns Mapped file or nullptr if the file can not be mapped
+    @param Path to the file*/
+    static std::shared_ptr<const MappedFile> acquire(const std::string& fileName);
+
+private:
+    std::vector<std::string> openedFiles;
+};
@@ -0,0 +1,452 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+namespace
+{
+    /*Forsyth scoring constants from the original article*/
+    const int FORSYTH_CACHE_SIZE = 32;
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+
+    /*cache used to find cluster boundaries in the overdraw optimization*/
+    const unsigned OVERDRAW_CACHE_SIZE = 16;
+
+    const size_t NO_TRIANGLE = SIZE_MAX;
+
+    /*valences above this use the score of the maximum, the boost is nearly flat there*/
+    const UINT MAX_SCORED_VALENCE = 32;
+
+    struct ScoreTables
+    {
+        float cache[FORSYTH_CACHE_SIZE];
+        float valence[MAX_SCORED_VALENCE + 1];
+
+        ScoreTables()
+        {
+            for (int i = 0; i < FORSYTH_CACHE_SIZE; i++)
+            {
+                /*the vertices of the last triangle get a fixed score so the next triangle does not reuse all of them*/
+                if (i < 3)
+                {
+                    cache[i] = LAST_TRIANGLE_SCORE;
+                }
+                else
+                {
+                    float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+                    cache[i] = std::pow(1.0f - (i - 3) * scaler, CACHE_DECAY_POWER);
+                }
+            }
+
+            /*vertices with few triangles left are preferred to get rid of them*/
+            valence[0] = 0.0f;
+
+            for (UINT i = 1; i <= MAX_SCORED_VALENCE; i++)
+            {
+                valence[i] = VALENCE_BOOST_SCALE * std::pow((float)i, -VALENCE_BOOST_POWER);
+            }
+        }
+    };
+
+    float vertexScore(int cachePosition, UINT remainingValence)
+    {
+        static const ScoreTables tables;
+
+        /*vertices without triangles left are never used again*/
+        if (remainingValence == 0)
+        {
+            return -1.0f;
+        }
+
+        float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+
+        return score + tables.valence[std::min(remainingValence, MAX_SCORED_VALENCE)];
+    }
+
+    /*FIFO cache with time stamps, a vertex is cached if it was added less than cacheSize misses ago*/
+    class FifoCache
+    {
+    public:
+        FifoCache(size_t vertexCount, unsigned cacheSize) : timeStamps(vertexCount, 0), cacheSize(cacheSize), time(cacheSize + 1) {}
+
+        unsigned addTriangle(const UINT* triangle)
+        {
+            unsigned misses = 0;
+
+            for (int k = 0; k < 3; k++)
+            {
+                if (time - timeStamps[triangle[k]] > cacheSize)
+                {
+                    timeStamps[triangle[k]] = time++;
+                    misses++;
+                }
+            }
+
+            return misses;
+        }
+
+        void clear()
+        {
+            time += cacheSize + 1;
+        }
+
+    private:
+        std::vector<unsigned> timeStamps;
+        unsigned cacheSize;
+        unsigned time;
+    };
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<UINT>& indices, size_t vertexCount, unsigned cacheSize)
+{
+    VertexCacheStats result;
+
+    size_t triangleCount = indices.size() / 3;
+
+    if (triangleCount == 0)
+    {
+        return result;
+    }
+
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> referenced(vertexCount, false);
+    size_t misses = 0;
+    size_t referencedCount = 0;
+
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        misses += cache.addTriangle(&indices[t * 3]);
+    }
+
+    for (UINT i : indices)
+    {
+        if (!referenced[i])
+        {
+            referenced[i] = true;
+            referencedCount++;
+        }
+    }
+
+    result.acmr = (float)misses / triangleCount;
+    result.atvr = (float)misses / referencedCount;
+
+    return result;
+}
+
+void optimizeVertexCache(std::vector<UINT>& indices, size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+
+    if (triangleCount < 2 || indices.size() % 3 != 0)
+    {
+        return;
+    }
+
+    /*triangles of every vertex, the live triangles of v are adjacency[offsets[v]] .. adjacency[offsets[v] + remaining[v]]*/
+    std::vector<UINT> remaining(vertexCount, 0);
+
+    for (UINT i : indices)
+    {
+        remaining[i]++;
+    }
+
+    std::vector<UINT> offsets(vertexCount + 1, 0);
+
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        offsets[v + 1] = offsets[v] + remaining[v];
+    }
+
+    std::vector<UINT> adjacency(indices.size());
+    std::vector<UINT> fill(offsets.begin(), offsets.end() - 1);
+
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        adjacency[fill[indices[i]]++] = (UINT)(i / 3);
+    }
+
+    /*initial scores*/
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    std::vector<float> triangleScores(triangleCount, 0.0f);
+    std::vector<bool> added(triangleCount, false);
+
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        vertexScores[v] = vertexScore(-1, remaining[v]);
+    }
+
+    size_t bestTriangle = 0;
+
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            triangleScores[t] += vertexScores[indices[t * 3 + k]];
+        }
+
+        if (triangleScores[t] > triangleScores[bestTriangle])
+        {
+            bestTriangle = t;
+        }
+    }
+
+    std::vector<UINT> result;
+    result.reserve(indices.size());
+
+    UINT cache[FORSYTH_CACHE_SIZE + 3];
+    int cacheCount = 0;
+    size_t nextUnadded = 0;
+
+    for (size_t n = 0; n < triangleCount; n++)
+    {
+        /*no cached vertex has triangles left, continue with the next unused triangle*/
+        if (bestTriangle == NO_TRIANGLE)
+        {
+            while (added[nextUnadded])
+            {
+                nextUnadded++;
+            }
+
+            bestTriangle = nextUnadded;
+        }
+
+        const UINT* triangle = &indices[bestTriangle * 3];
+        added[bestTriangle] = true;
+        result.insert(result.end(), triangle, triangle + 3);
+
+        /*remove the triangle from the live triangles of its vertices*/
+        for (int k = 0; k < 3; k++)
+        {
+            UINT v = triangle[k];
+            UINT* list = &adjacency[offsets[v]];
+
+            for (UINT j = 0; j < remaining[v]; j++)
+            {
+                if (list[j] == bestTriangle)
+                {
+                    list[j] = list[remaining[v] - 1];
+                    remaining[v]--;
+                    break;
+                }
+            }
+        }
+
+        /*the triangle's vertices move to the front, the rest of the cache moves back*/
+        UINT newCache[FORSYTH_CACHE_SIZE + 3];
+        int newCount = 0;
+
+        for (int k = 0; k < 3; k++)
+        {
+            if (std::find(newCache, newCache + newCount, triangle[k]) == newCache + newCount)
+            {
+                newCache[newCount++] = triangle[k];
+            }
+        }
+
+        for (int i = 0; i < cacheCount; i++)
+        {
+            if (cache[i] != triangle[0] && cache[i] != triangle[1] && cache[i] != triangle[2])
+            {
+                newCache[newCount++] = cache[i];
+            }
+        }
+
+        /*update the scores of all cached vertices and the ones that just dropped out*/
+        for (int i = 0; i < newCount; i++)
+        {
+            UINT v = newCache[i];
+            cachePosition[v] = i < FORSYTH_CACHE_SIZE ? i : -1;
+
+            float score = vertexScore(cachePosition[v], remaining[v]);
+            float delta = score - vertexScores[v];
+            vertexScores[v] = score;
+
+            for (UINT j = 0; j < remaining[v]; j++)
+            {
+                triangleScores[adjacency[offsets[v] + j]] += delta;
+            }
+        }
+
+        cacheCount = std::min(newCount, FORSYTH_CACHE_SIZE);
+
+        for (int i = 0; i < cacheCount; i++)
+        {
+            cache[i] = newCache[i];
+        }
+
+        /*the next triangle is the best one that uses a cached vertex*/
+        bestTriangle = NO_TRIANGLE;
+        float bestScore = -1.0f;
+
+        for (int i = 0; i < cacheCount; i++)
+        {
+            UINT v = cache[i];
+
+            for (UINT j = 0; j < remaining[v]; j++)
+            {
+                UINT t = adjacency[offsets[v] + j];
+
+                if (triangleScores[t] > bestScore)
+                {
+                    bestScore = triangleScores[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+    }
+
+    indices.swap(result);
+}
+
+void optimizeOverdraw(std::vector<UINT>& indices, const std::vector<Vertex>& vertices, float threshold)
+{
+    size_t triangleCount = indices.size() / 3;
+
+    if (triangleCount < 2 || indices.size() % 3 != 0)
+    {
+        return;
+    }
+
+    FifoCache cache(vertices.size(), OVERDRAW_CACHE_SIZE);
+
+    /*hard boundaries where the cache restarts, every vertex of the triangle misses*/
+    std::vector<size_t> hardBoundaries;
+
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        if (cache.addTriangle(&indices[t * 3]) == 3 || t == 0)
+        {
+            hardBoundaries.push_back(t);
+        }
+    }
+
+    hardBoundaries.push_back(triangleCount);
+
+    /*soft boundaries inside every hard cluster where the cache efficiency so far is close to the cluster's*/
+    std::vector<size_t> clusters;
+
+    for (size_t h = 0; h + 1 < hardBoundaries.size(); h++)
+    {
+        size_t start = hardBoundaries[h];
+        size_t end = hardBoundaries[h + 1];
+
+        cache.clear();
+        size_t clusterMisses = 0;
+
+        for (size_t t = start; t < end; t++)
+        {
+            clusterMisses += cache.addTriangle(&indices[t * 3]);
+        }
+
+        float clusterThreshold = threshold * clusterMisses / (end - start);
+
+        cache.clear();
+        clusters.push_back(start);
+
+        size_t clusterStart = start;
+        size_t misses = 0;
+
+        for (size_t t = start; t + 1 < end; t++)
+        {
+            misses += cache.addTriangle(&indices[t * 3]);
+
+            if ((float)misses / (t + 1 - clusterStart) <= clusterThreshold)
+            {
+                clusters.push_back(t + 1);
+                clusterStart = t + 1;
+                misses = 0;
+                cache.clear();
+            }
+        }
+    }
+
+    clusters.push_back(triangleCount);
+
+    /*mesh centroid*/
+    aiVector3D meshCentroid;
+
+    for (UINT i : indices)
+    {
+        meshCentroid += vertices[i].Position;
+    }
+
+    meshCentroid /= (float)indices.size();
+
+    /*clusters facing away from the centroid are drawn first*/
+    std::vector<std::pair<float, size_t>> sortKeys(clusters.size() - 1);
+
+    for (size_t c = 0; c + 1 < clusters.size(); c++)
+    {
+        aiVector3D centroid;
+        aiVector3D normal;
+        float area = 0.0f;
+
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+        {
+            const aiVector3D& p0 = vertices[indices[t * 3 + 0]].Position;
+            const aiVector3D& p1 = vertices[indices[t * 3 + 1]].Position;
+            const aiVector3D& p2 = vertices[indices[t * 3 + 2]].Position;
+
+            aiVector3D n = (p1 - p0) ^ (p2 - p0);
+            float triangleArea = n.Length();
+
+            centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+            normal += n;
+            area += triangleArea;
+        }
+
+        if (area > 0.0f)
+        {
+            centroid /= area;
+        }
+
+        float normalLength = normal.Length();
+
+        if (normalLength > 0.0f)
+        {
+            normal /= normalLength;
+        }
+
+        sortKeys[c] = std::make_pair((centroid - meshCentroid) * normal, c);
+    }
+
+    std::stable_sort(sortKeys.begin(), sortKeys.end(), [](const std::pair<float, size_t>& a, const std::pair<float, size_t>& b) { return a.first > b.first; });
+
+    std::vector<UINT> result;
+    result.reserve(indices.size());
+
+    for (const auto& k : sortKeys)
+    {
+        result.insert(result.end(), indices.begin() + clusters[k.second] * 3, indices.begin() + clusters[k.second + 1] * 3);
+    }
+
+    indices.swap(result);
+}
+
+size_t optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<UINT>& indices)
+{
+    std::vector<UINT> remap(vertices.size(), UINT_MAX);
+    std::vector<Vertex> result;
+    result.reserve(vertices.size());
+
+    for (UINT& i : indices)
+    {
+        if (remap[i] == UINT_MAX)
+        {
+            remap[i] = (UINT)result.size();
+            result.push_back(vertices[i]);
+        }
+
+        i = remap[i];
+    }
+
+    size_t dropped = vertices.size() - result.size();
+    vertices.swap(result);
+
+    return dropped;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#include "data.h"
+
+/*results of a simulated FIFO post-transform vertex cache*/
+struct VertexCacheStats
+{
+    float acmr = 0.0f; /*average cache miss ratio, transformed vertices per triangle (0.5 - 3)*/
+    float atvr = 0.0f; /*average transform to vertex ratio, transformed vertices per referenced vertex (1 is optimal)*/
+};
+
+/*
+Simulates a FIFO vertex cache over a triangle list.
+@returns Cache statistics
+@param Triangle list
+@param Number of vertices the indices refer to
+@param Number of cache entries*/
+VertexCacheStats analyzeVertexCache(const std::vector<UINT>& indices, size_t vertexCount, unsigned cacheSize = 16);
+
+/*
+Reorders the triangles for the post-transform vertex cache with Tom Forsyth's
+linear-speed algorithm.
+@param Triangle list to reorder
+@param Number of vertices the indices refer to*/
+void optimizeVertexCache(std::vector<UINT>& indices, size_t vertexCount);
+
+/*
+Reorders clusters of a cache optimized triangle list so outward facing
+clusters are drawn first, which lets early depth testing reject more of the
+hidden surfaces. Clusters are cut where the vertex cache restarts and where
+the cache efficiency stays within threshold of the cluster's efficiency.
+@param Cache optimized triangle list to reorder
+@param Vertices the indices refer to
+@param Allowed ACMR increase, 1.05 allows 5%*/
+void optimizeOverdraw(std::vector<UINT>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+
+/*
+Reorders the vertices in the order they are first referenced and drops the
+vertices no triangle refers to.
+@returns Number of dropped vertices
+@param Vertices to reorder
+@param Triangle list, indices are remapped*/
+size_t optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<UINT>& indices);
@@ -0,0 +1,739 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <numeric>
+#include <sstream>
+
+namespace
+{
+    enum VertexKind
+    {
+        KIND_MANIFOLD, /*interior vertex without siblings*/
+        KIND_BORDER, /*vertex on an open border*/
+        KIND_SEAM, /*vertex on a texture or normal seam, has exactly one sibling at the same position*/
+        KIND_LOCKED, /*everything else, e.g. where seams meet borders or other seams*/
+        KIND_COUNT
+    };
+
+    /*source kind -> target kind, borders and seams only collapse along themselves*/
+    const bool CAN_COLLAPSE[KIND_COUNT][KIND_COUNT] =
+    {
+        { true, true, true, true },
+        { false, true, false, false },
+        { false, false, true, false },
+        { false, false, false, false },
+    };
+
+    /*planes through open edges keep borders in place, seams are interior and get less*/
+    const double BORDER_WEIGHT = 10.0;
+    const double SEAM_WEIGHT = 1.0;
+
+    /*attribute differences in units of squared relative distance, 0.1 in uv costs as much as 1% of the extent*/
+    const double TEXTURE_WEIGHT = 0.01;
+    const double NORMAL_WEIGHT = 0.002;
+    const double BLEND_WEIGHT = 0.005;
+
+    /*collapses per pass may cost this much more than the one reaching the pass goal*/
+    const double PASS_ERROR_SLACK = 1.5;
+
+    const UINT NO_VERTEX = UINT_MAX;
+
+    struct Point
+    {
+        double x, y, z;
+
+        Point operator-(const Point& p) const { return { x - p.x, y - p.y, z - p.z }; }
+    };
+
+    Point cross(const Point& a, const Point& b)
+    {
+        return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    }
+
+    double dot(const Point& a, const Point& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    /*symmetric 4x4 matrix summing the squared distances to a set of weighted planes*/
+    struct Quadric
+    {
+        double a00 = 0.0, a11 = 0.0, a22 = 0.0;
+        double a10 = 0.0, a20 = 0.0, a21 = 0.0;
+        double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+        double c = 0.0;
+        double weight = 0.0;
+
+        /*plane n * p + d = 0 with a unit normal*/
+        void addPlane(const Point& n, double d, double w)
+        {
+            a00 += w * n.x * n.x;
+            a11 += w * n.y * n.y;
+            a22 += w * n.z * n.z;
+            a10 += w * n.y * n.x;
+            a20 += w * n.z * n.x;
+            a21 += w * n.z * n.y;
+            b0 += w * n.x * d;
+            b1 += w * n.y * d;
+            b2 += w * n.z * d;
+            c += w * d * d;
+            weight += w;
+        }
+
+        void add(const Quadric& q)
+        {
+            a00 += q.a00;
+            a11 += q.a11;
+            a22 += q.a22;
+            a10 += q.a10;
+            a20 += q.a20;
+            a21 += q.a21;
+            b0 += q.b0;
+            b1 += q.b1;
+            b2 += q.b2;
+            c += q.c;
+            weight += q.weight;
+        }
+
+        /*weighted mean of the squared distances of the point to the planes*/
+        double error(const Point& p) const
+        {
+            double rx = a00 * p.x + a10 * p.y + a20 * p.z;
+            double ry = a10 * p.x + a11 * p.y + a21 * p.z;
+            double rz = a20 * p.x + a21 * p.y + a22 * p.z;
+            double r = rx * p.x + ry * p.y + rz * p.z + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+
+            return weight > 0.0 ? std::fabs(r) / weight : 0.0;
+        }
+    };
+
+    /*outgoing half-edges of every vertex*/
+    struct EdgeAdjacency
+    {
+        std::vector<UINT> offsets;
+        std::vector<UINT> targets;
+
+        void build(const std::vector<UINT>& indices, size_t vertexCount)
+        {
+            offsets.assign(vertexCount + 1, 0);
+
+            for (UINT i : indices)
+            {
+                offsets[i + 1]++;
+            }
+
+            std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+            std::vector<UINT> fill(offsets.begin(), offsets.end() - 1);
+            targets.resize(indices.size());
+
+            for (size_t t = 0; t < indices.size(); t += 3)
+            {
+                for (int e = 0; e < 3; e++)
+                {
+                    targets[fill[indices[t + e]]++] = indices[t + (e + 1) % 3];
+                }
+            }
+        }
+
+        bool hasEdge(UINT a, UINT b) const
+        {
+            for (UINT k = offsets[a]; k < offsets[a + 1]; k++)
+            {
+                if (targets[k] == b)
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+    };
+
+    /*triangles around every position, indexed by the position's representative vertex*/
+    struct TriangleAdjacency
+    {
+        std::vector<UINT> offsets;
+        std::vector<UINT> triangles;
+
+        void build(const std::vector<UINT>& indices, const std::vector<UINT>& remap)
+        {
+            offsets.assign(remap.size() + 1, 0);
+
+            for (UINT i : indices)
+            {
+                offsets[remap[i] + 1]++;
+            }
+
+            std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+            std::vector<UINT> fill(offsets.begin(), offsets.end() - 1);
+            triangles.resize(indices.size());
+
+            for (size_t i = 0; i < indices.size(); i++)
+            {
+                triangles[fill[remap[indices[i]]]++] = (UINT)(i / 3);
+            }
+        }
+    };
+
+    /*v0 is collapsed onto v1, for seams the sibling s0 is collapsed onto s1 as well*/
+    struct Collapse
+    {
+        UINT v0;
+        UINT v1;
+        UINT s0;
+        UINT s1;
+        double error;
+    };
+
+    float blendWeight(const Vertex& v, UINT bone)
+    {
+        float weight = 0.0f;
+
+        for (int k = 0; k < MAX_BONE_INFLUENCES; k++)
+        {
+            if (v.BlendWeights[k] > 0.0f && v.BlendIndices[k] == bone)
+            {
+                weight += v.BlendWeights[k];
+            }
+        }
+
+        return weight;
+    }
+
+    /*weighted squared difference of texture coordinates, normals and bone weights*/
+    double attributeDistance(const Vertex& a, const Vertex& b)
+    {
+        double du = a.Texture.x - b.Texture.x;
+        double dv = a.Texture.y - b.Texture.y;
+        double normal = (a.Normal - b.Normal).SquareLength();
+        double blend = 0.0;
+
+        for (int k = 0; k < MAX_BONE_INFLUENCES; k++)
+        {
+            if (a.BlendWeights[k] > 0.0f)
+            {
+                double d = a.BlendWeights[k] - blendWeight(b, a.BlendIndices[k]);
+                blend += d * d;
+            }
+
+            if (b.BlendWeights[k] > 0.0f && blendWeight(a, b.BlendIndices[k]) == 0.0f)
+            {
+                blend += (double)b.BlendWeights[k] * b.BlendWeights[k];
+            }
+        }
+
+        return TEXTURE_WEIGHT * (du * du + dv * dv) + NORMAL_WEIGHT * normal + BLEND_WEIGHT * blend;
+    }
+
+    /*positions scaled into the unit cube, errors are relative to the mesh extent this way*/
+    std::vector<Point> normalizePositions(const std::vector<Vertex>& vertices, const std::vector<bool>& referenced)
+    {
+        aiVector3D vMin = { +FLT_MAX, +FLT_MAX, +FLT_MAX };
+        aiVector3D vMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+        for (size_t v = 0; v < vertices.size(); v++)
+        {
+            if (referenced[v])
+            {
+                const aiVector3D& p = vertices[v].Position;
+
+                vMin = { std::min(vMin.x, p.x), std::min(vMin.y, p.y), std::min(vMin.z, p.z) };
+                vMax = { std::max(vMax.x, p.x), std::max(vMax.y, p.y), std::max(vMax.z, p.z) };
+            }
+        }
+
+        double extent = std::max(std::max(vMax.x - vMin.x, vMax.y - vMin.y), vMax.z - vMin.z);
+        double scale = extent > 0.0 ? 1.0 / extent : 1.0;
+
+        std::vector<Point> positions(vertices.size(), Point{ 0.0, 0.0, 0.0 });
+
+        for (size_t v = 0; v < vertices.size(); v++)
+        {
+            if (referenced[v])
+            {
+                const aiVector3D& p = vertices[v].Position;
+                positions[v] = { (p.x - vMin.x) * scale, (p.y - vMin.y) * scale, (p.z - vMin.z) * scale };
+            }
+        }
+
+        return positions;
+    }
+
+    /*
+    Groups vertices with the same position. remap points to the first vertex
+    of the group, wedge links the vertices of a group to a cycle.*/
+    void buildPositionRemap(const std::vector<Vertex>& vertices, const std::vector<bool>& referenced, std::vector<UINT>& remap, std::vector<UINT>& wedge)
+    {
+        remap.resize(vertices.size());
+        wedge.resize(vertices.size());
+        std::iota(remap.begin(), remap.end(), 0);
+        std::iota(wedge.begin(), wedge.end(), 0);
+
+        std::vector<UINT> order;
+
+        for (UINT v = 0; v < (UINT)vertices.size(); v++)
+        {
+            if (referenced[v])
+            {
+                order.push_back(v);
+            }
+        }
+
+        auto less = [&](UINT a, UINT b)
+        {
+            const aiVector3D& pa = vertices[a].Position;
+            const aiVector3D& pb = vertices[b].Position;
+
+            if (pa.x != pb.x) return pa.x < pb.x;
+            if (pa.y != pb.y) return pa.y < pb.y;
+            if (pa.z != pb.z) return pa.z < pb.z;
+            return a < b;
+        };
+
+        std::sort(order.begin(), order.end(), less);
+
+        for (size_t first = 0; first < order.size();)
+        {
+            size_t last = first + 1;
+
+            while (last < order.size() && vertices[order[last]].Position == vertices[order[first]].Position)
+            {
+                last++;
+            }
+
+            for (size_t k = first; k < last; k++)
+            {
+                remap[order[k]] = order[first];
+                wedge[order[k]] = order[k + 1 < last ? k + 1 : first];
+            }
+
+            first = last;
+        }
+    }
+
+    /*
+    Finds the half-edges without an opposite half-edge. openIn and openOut hold
+    the other vertex of the single open edge ending or starting at a vertex,
+    NO_VERTEX if there is none and the vertex itself if there are several.*/
+    void findOpenEdges(const EdgeAdjacency& adjacency, std::vector<UINT>& openIn, std::vector<UINT>& openOut)
+    {
+        size_t vertexCount = adjacency.offsets.size() - 1;
+
+        openIn.assign(vertexCount, NO_VERTEX);
+        openOut.assign(vertexCount, NO_VERTEX);
+
+        for (UINT v = 0; v < (UINT)vertexCount; v++)
+        {
+            for (UINT k = adjacency.offsets[v]; k < adjacency.offsets[v + 1]; k++)
+            {
+                UINT t = adjacency.targets[k];
+
+                if (!adjacency.hasEdge(t, v))
+                {
+                    openIn[t] = openIn[t] == NO_VERTEX ? v : t;
+                    openOut[v] = openOut[v] == NO_VERTEX ? t : v;
+                }
+            }
+        }
+    }
+
+    std::vector<VertexKind> classifyVertices(const std::vector<UINT>& remap, const std::vector<UINT>& wedge, const std::vector<UINT>& openIn, const std::vector<UINT>& openOut)
+    {
+        std::vector<VertexKind> kinds(remap.size(), KIND_LOCKED);
+
+        auto single = [](UINT open, UINT v) { return open != NO_VERTEX && open != v; };
+
+        for (UINT v = 0; v < (UINT)remap.size(); v++)
+        {
+            if (wedge[v] == v)
+            {
+                if (openIn[v] == NO_VERTEX && openOut[v] == NO_VERTEX)
+                {
+                    kinds[v] = KIND_MANIFOLD;
+                }
+                else if (single(openIn[v], v) && single(openOut[v], v))
+                {
+                    kinds[v] = KIND_BORDER;
+                }
+            }
+            else if (wedge[wedge[v]] == v)
+            {
+                /*both siblings have one open edge in each direction and these run along the same positions*/
+                UINT w = wedge[v];
+
+                if (single(openIn[v], v) && single(openOut[v], v) && single(openIn[w], w) && single(openOut[w], w) &&
+                    remap[openIn[v]] == remap[openOut[w]] && remap[openOut[v]] == remap[openIn[w]])
+                {
+                    kinds[v] = KIND_SEAM;
+                }
+            }
+        }
+
+        return kinds;
+    }
+
+    void addFaceQuadrics(std::vector<Quadric>& quadrics, const std::vector<UINT>& indices, const std::vector<Point>& positions, const std::vector<UINT>& remap)
+    {
+        for (size_t t = 0; t < indices.size(); t += 3)
+        {
+            const Point& p0 = positions[indices[t + 0]];
+            const Point& p1 = positions[indices[t + 1]];
+            const Point& p2 = positions[indices[t + 2]];
+
+            Point n = cross(p1 - p0, p2 - p0);
+            double length = std::sqrt(dot(n, n));
+
+            if (length == 0.0)
+            {
+                continue;
+            }
+
+            n = { n.x / length, n.y / length, n.z / length };
+
+            /*weighted by area so small triangles do not dominate*/
+            Quadric q;
+            q.addPlane(n, -dot(n, p0), length);
+
+            for (int k = 0; k < 3; k++)
+            {
+                quadrics[remap[indices[t + k]]].add(q);
+            }
+        }
+    }
+
+    void addEdgeQuadrics(std::vector<Quadric>& quadrics, const std::vector<UINT>& indices, const std::vector<Point>& positions,
+        const std::vector<UINT>& remap, const std::vector<UINT>& wedge, const EdgeAdjacency& adjacency)
+    {
+        for (size_t t = 0; t < indices.size(); t += 3)
+        {
+            for (int e = 0; e < 3; e++)
+            {
+                UINT i0 = indices[t + e];
+                UINT i1 = indices[t + (e + 1) % 3];
+                UINT i2 = indices[t + (e + 2) % 3];
+
+                if (adjacency.hasEdge(i1, i0))
+                {
+                    continue;
+                }
+
+                const Point& p0 = positions[i0];
+                Point edge = positions[i1] - p0;
+                Point n = cross(edge, positions[i2] - p0);
+
+                /*plane through the edge, perpendicular to the triangle*/
+                Point planeNormal = cross(edge, n);
+                double length = std::sqrt(dot(planeNormal, planeNormal));
+
+                if (length == 0.0)
+                {
+                    continue;
+                }
+
+                planeNormal = { planeNormal.x / length, planeNormal.y / length, planeNormal.z / length };
+
+                bool seam = wedge[i0] != i0 && wedge[i1] != i1;
+
+                Quadric q;
+                q.addPlane(planeNormal, -dot(planeNormal, p0), std::sqrt(dot(edge, edge)) * (seam ? SEAM_WEIGHT : BORDER_WEIGHT));
+
+                quadrics[remap[i0]].add(q);
+                quadrics[remap[i1]].add(q);
+            }
+        }
+    }
+}
+
+float simplifyMesh(std::vector<UINT>& indices, const std::vector<Vertex>& vertices, size_t targetIndexCount, float maxError)
+{
+    size_t vertexCount = vertices.size();
+
+    if (indices.size() <= targetIndexCount || vertexCount == 0)
+    {
+        return 0.0f;
+    }
+
+    std::vector<bool> referenced(vertexCount, false);
+
+    for (UINT i : indices)
+    {
+        referenced[i] = true;
+    }
+
+    std::vector<Point> positions = normalizePositions(vertices, referenced);
+
+    std::vector<UINT> remap;
+    std::vector<UINT> wedge;
+    buildPositionRemap(vertices, referenced, remap, wedge);
+
+    EdgeAdjacency edges;
+    edges.build(indices, vertexCount);
+
+    std::vector<UINT> openIn;
+    std::vector<UINT> openOut;
+    findOpenEdges(edges, openIn, openOut);
+
+    /*kinds are kept for the whole simplification, collapses along borders and seams keep them intact*/
+    std::vector<VertexKind> kinds = classifyVertices(remap, wedge, openIn, openOut);
+
+    std::vector<Quadric> quadrics(vertexCount);
+    addFaceQuadrics(quadrics, indices, positions, remap);
+    addEdgeQuadrics(quadrics, indices, positions, remap, wedge, edges);
+
+    double errorLimit = (double)maxError * maxError;
+    double resultError = 0.0;
+
+    TriangleAdjacency triangles;
+    std::vector<Collapse> collapses;
+    std::vector<UINT> collapseRemap(vertexCount);
+    std::vector<char> locked(vertexCount);
+
+    /*
+    Returns if v0 can collapse onto v1 and fills the collapse. Border and seam
+    vertices have to move along their open edge, the sibling of a seam vertex
+    moves along the open edge running the other way.*/
+    auto evaluate = [&](UINT v0, UINT v1, bool open, Collapse& c) -> bool
+    {
+        VertexKind k0 = kinds[v0];
+
+        if (!CAN_COLLAPSE[k0][kinds[v1]])
+        {
+            return false;
+        }
+
+        c = { v0, v1, NO_VERTEX, NO_VERTEX, 0.0 };
+
+        if (k0 == KIND_BORDER || k0 == KIND_SEAM)
+        {
+            if (!open || (openOut[v0] != v1 && openIn[v0] != v1))
+            {
+                return false;
+            }
+        }
+
+        if (k0 == KIND_SEAM)
+        {
+            c.s0 = wedge[v0];
+            c.s1 = openOut[v0] == v1 ? openIn[c.s0] : openOut[c.s0];
+
+            if (c.s1 == NO_VERTEX || c.s1 == c.s0 || c.s1 == v1 || remap[c.s1] != remap[v1])
+            {
+                return false;
+            }
+        }
+
+        Quadric q = quadrics[remap[v0]];
+        q.add(quadrics[remap[v1]]);
+
+        c.error = q.error(positions[v1]) + attributeDistance(vertices[v0], vertices[v1]);
+
+        if (c.s0 != NO_VERTEX)
+        {
+            c.error += attributeDistance(vertices[c.s0], vertices[c.s1]);
+        }
+
+        return true;
+    };
+
+    /*
+    Checks that no triangle around the collapsed position flips and counts
+    the triangles that degenerate.*/
+    auto flips = [&](const Collapse& c, size_t& degenerate) -> bool
+    {
+        UINT r0 = remap[c.v0];
+        UINT r1 = remap[c.v1];
+
+        degenerate = 0;
+
+        for (UINT k = triangles.offsets[r0]; k < triangles.offsets[r0 + 1]; k++)
+        {
+            size_t t = (size_t)triangles.triangles[k] * 3;
+            Point before[3];
+            Point after[3];
+            bool removed = false;
+
+            for (int j = 0; j < 3; j++)
+            {
+                UINT r = remap[indices[t + j]];
+
+                removed |= r == r1;
+                before[j] = positions[indices[t + j]];
+                after[j] = r == r0 ? positions[c.v1] : before[j];
+            }
+
+            if (removed)
+            {
+                degenerate++;
+                continue;
+            }
+
+            Point n0 = cross(before[1] - before[0], before[2] - before[0]);
+            Point n1 = cross(after[1] - after[0], after[2] - after[0]);
+
+            if (dot(n0, n1) < 0.0 || (dot(n1, n1) == 0.0 && dot(n0, n0) > 0.0))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    };
+
+    while (indices.size() > targetIndexCount)
+    {
+        triangles.build(indices, remap);
+
+        /*cheapest direction of every edge, interior edges are seen from both triangles*/
+        collapses.clear();
+
+        for (size_t t = 0; t < indices.size(); t += 3)
+        {
+            for (int e = 0; e < 3; e++)
+            {
+                UINT i0 = indices[t + e];
+                UINT i1 = indices[t + (e + 1) % 3];
+
+                if (remap[i0] == remap[i1])
+                {
+                    continue;
+                }
+
+                bool open = !edges.hasEdge(i1, i0);
+
+                if (!open && i0 > i1)
+                {
+                    continue;
+                }
+
+                Collapse forward;
+                Collapse backward;
+                bool canForward = evaluate(i0, i1, open, forward);
+                bool canBackward = evaluate(i1, i0, open, backward);
+
+                if (canForward || canBackward)
+                {
+                    collapses.push_back(canForward && (!canBackward || forward.error <= backward.error) ? forward : backward);
+                }
+            }
+        }
+
+        if (collapses.empty())
+        {
+            break;
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+        /*every collapse removes about two triangles, collapses far above the cost of reaching the goal wait for the next pass*/
+        size_t triangleGoal = (indices.size() - targetIndexCount + 2) / 3;
+        double passLimit = std::min(errorLimit, collapses[std::min(triangleGoal / 2, collapses.size() - 1)].error * PASS_ERROR_SLACK);
+
+        std::iota(collapseRemap.begin(), collapseRemap.end(), 0);
+        std::fill(locked.begin(), locked.end(), 0);
+
+        size_t removedTriangles = 0;
+        size_t applied = 0;
+
+        for (const Collapse& c : collapses)
+        {
+            if (c.error > passLimit || removedTriangles >= triangleGoal)
+            {
+                break;
+            }
+
+            UINT r0 = remap[c.v0];
+            UINT r1 = remap[c.v1];
+            size_t degenerate = 0;
+
+            if (locked[r0] || locked[r1] || flips(c, degenerate))
+            {
+                continue;
+            }
+
+            /*the triangles around the collapsed position are final for this pass*/
+            for (UINT k = triangles.offsets[r0]; k < triangles.offsets[r0 + 1]; k++)
+            {
+                size_t t = (size_t)triangles.triangles[k] * 3;
+
+                for (int j = 0; j < 3; j++)
+                {
+                    locked[remap[indices[t + j]]] = 1;
+                }
+            }
+
+            locked[r1] = 1;
+
+            collapseRemap[c.v0] = c.v1;
+
+            if (c.s0 != NO_VERTEX)
+            {
+                collapseRemap[c.s0] = c.s1;
+            }
+
+            quadrics[r1].add(quadrics[r0]);
+
+            removedTriangles += degenerate;
+            resultError = std::max(resultError, c.error);
+            applied++;
+        }
+
+        if (applied == 0)
+        {
+            break;
+        }
+
+        /*apply the collapses and drop the triangles that lost their area*/
+        size_t write = 0;
+
+        for (size_t t = 0; t < indices.size(); t += 3)
+        {
+            UINT a = collapseRemap[indices[t + 0]];
+            UINT b = collapseRemap[indices[t + 1]];
+            UINT c = collapseRemap[indices[t + 2]];
+
+            if (remap[a] != remap[b] && remap[b] != remap[c] && remap[c] != remap[a])
+            {
+                indices[write + 0] = a;
+                indices[write + 1] = b;
+                indices[write + 2] = c;
+                write += 3;
+            }
+        }
+
+        indices.resize(write);
+
+        edges.build(indices, vertexCount);
+        findOpenEdges(edges, openIn, openOut);
+    }
+
+    return (float)std::sqrt(resultError);
+}
+
+bool parseLodRatios(const std::string& list, std::vector<float>& ratios)
+{
+    std::stringstream ss(list);
+    std::string item;
+
+    ratios.clear();
+
+    while (std::getline(ss, item, ','))
+    {
+        char* end = nullptr;
+        float ratio = std::strtof(item.c_str(), &end);
+
+        if (item.empty() || *end != '\0' || !(ratio > 0.0f && ratio < 1.0f) || (!ratios.empty() && ratio >= ratios.back()))
+        {
+            return false;
+        }
+
+        ratios.push_back(ratio);
+    }
+
+    return !ratios.empty();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "data.h"
+
+/*
+Simplifies a triangle list with quadric error metric edge collapses. A vertex
+is always collapsed onto one of its neighbours, so texture coordinates,
+normals and bone influences of the result are taken over unchanged. Vertices
+on open borders and on texture or normal seams only collapse along the border
+or seam, both sides of a seam collapse together. The difference of texture
+coordinates, normals and bone weights between the two vertices is added to
+the geometric error of a collapse.
+@returns Largest error of all collapses, relative to the mesh extent
+@param Triangle list, replaced by the simplified one
+@param Vertices the indices refer to, vertices no longer referenced are left in place
+@param Number of indices to reduce the list to
+@param Largest allowed error relative to the mesh extent, simplification stops before exceeding it*/
+float simplifyMesh(std::vector<UINT>& indices, const std::vector<Vertex>& vertices, size_t targetIndexCount, float maxError = 0.01f);
+
+/*
+Parses a comma separated list of LOD ratios, e.g. "0.5,0.25". Every ratio is
+the fraction of the original triangles kept by that level and must be
+between 0 and 1, the list must be descending.
+@returns false if the list is malformed
+@param List to parse
+@param Parsed ratios*/
+bool parseLodRatios(const std::string& list, std::vector<float>& ratios);
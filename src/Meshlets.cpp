@@ -0,0 +1,287 @@
+#include "Meshlets.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+    const UINT NO_TRIANGLE = UINT_MAX;
+
+    /*cones wider than this are useless for culling and are disabled*/
+    const float MIN_CONE_DOT = 0.1f;
+
+    /*approximate bounding sphere after Ritter, starts from the most distant pair of axis extremes*/
+    void computeSphere(const std::vector<aiVector3D>& points, aiVector3D& center, float& radius)
+    {
+        size_t minIndex[3] = { 0, 0, 0 };
+        size_t maxIndex[3] = { 0, 0, 0 };
+
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                if (points[i][k] < points[minIndex[k]][k]) minIndex[k] = i;
+                if (points[i][k] > points[maxIndex[k]][k]) maxIndex[k] = i;
+            }
+        }
+
+        int axis = 0;
+        float maxDistance = -1.0f;
+
+        for (int k = 0; k < 3; k++)
+        {
+            float distance = (points[maxIndex[k]] - points[minIndex[k]]).SquareLength();
+
+            if (distance > maxDistance)
+            {
+                maxDistance = distance;
+                axis = k;
+            }
+        }
+
+        center = (points[minIndex[axis]] + points[maxIndex[axis]]) * 0.5f;
+        radius = std::sqrt(maxDistance) * 0.5f;
+
+        /*grow the sphere just enough to include every outside point*/
+        for (const auto& p : points)
+        {
+            float distance = (p - center).Length();
+
+            if (distance > radius)
+            {
+                float shift = (distance - radius) * 0.5f;
+
+                center += (p - center) * (shift / distance);
+                radius += shift;
+            }
+        }
+    }
+
+    /*cone containing the normals of all triangles, the apex is placed so all triangle planes are behind it*/
+    void computeCone(const std::vector<aiVector3D>& corners, const aiVector3D& center, Meshlet& meshlet)
+    {
+        std::vector<aiVector3D> normals;
+        aiVector3D axis;
+
+        for (size_t t = 0; t < corners.size(); t += 3)
+        {
+            aiVector3D n = (corners[t + 1] - corners[t]) ^ (corners[t + 2] - corners[t]);
+            float length = n.Length();
+
+            if (length > 0.0f)
+            {
+                normals.push_back(n / length);
+                axis += normals.back();
+            }
+            else
+            {
+                normals.push_back(aiVector3D());
+            }
+        }
+
+        meshlet.coneApex = center;
+        meshlet.coneAxis = aiVector3D();
+        meshlet.coneCutoff = 1.0f;
+
+        float axisLength = axis.Length();
+
+        if (axisLength == 0.0f)
+        {
+            return;
+        }
+
+        axis /= axisLength;
+        meshlet.coneAxis = axis;
+
+        float minDot = 1.0f;
+
+        for (const auto& n : normals)
+        {
+            if (n.SquareLength() > 0.0f)
+            {
+                minDot = std::min(minDot, n * axis);
+            }
+        }
+
+        if (minDot <= MIN_CONE_DOT)
+        {
+            return;
+        }
+
+        float maxT = 0.0f;
+
+        for (size_t t = 0; t < corners.size(); t += 3)
+        {
+            const aiVector3D& n = normals[t / 3];
+
+            if (n.SquareLength() > 0.0f)
+            {
+                maxT = std::max(maxT, ((center - corners[t]) * n) / (axis * n));
+            }
+        }
+
+        meshlet.coneApex = center - axis * maxT;
+        meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+
+    void finishMeshlet(MeshletData& data, Meshlet& meshlet, const std::vector<Vertex>& vertices)
+    {
+        std::vector<aiVector3D> points(meshlet.vertexCount);
+        std::vector<aiVector3D> corners(meshlet.triangleCount * 3);
+
+        for (UINT k = 0; k < meshlet.vertexCount; k++)
+        {
+            points[k] = vertices[data.vertices[meshlet.vertexOffset + k]].Position;
+        }
+
+        for (UINT k = 0; k < meshlet.triangleCount * 3; k++)
+        {
+            corners[k] = points[data.triangles[meshlet.triangleOffset + k]];
+        }
+
+        computeSphere(points, meshlet.center, meshlet.radius);
+        computeCone(corners, meshlet.center, meshlet);
+
+        data.meshlets.push_back(meshlet);
+
+        meshlet = Meshlet();
+        meshlet.vertexOffset = (UINT)data.vertices.size();
+        meshlet.triangleOffset = (UINT)data.triangles.size();
+    }
+}
+
+MeshletData buildMeshlets(const std::vector<UINT>& indices, const std::vector<Vertex>& vertices, size_t maxVertices, size_t maxTriangles)
+{
+    MeshletData data;
+    size_t triangleCount = indices.size() / 3;
+
+    /*counts and local indices are stored as bytes*/
+    maxVertices = std::min(std::max(maxVertices, (size_t)3), (size_t)255);
+    maxTriangles = std::min(std::max(maxTriangles, (size_t)1), (size_t)255);
+
+    /*triangles of every vertex*/
+    std::vector<UINT> offsets(vertices.size() + 1, 0);
+    std::vector<UINT> adjacency(indices.size());
+
+    for (UINT i : indices)
+    {
+        offsets[i + 1]++;
+    }
+
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<UINT> fill(offsets.begin(), offsets.end() - 1);
+
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        adjacency[fill[indices[i]]++] = (UINT)(i / 3);
+    }
+
+    std::vector<aiVector3D> centroids(triangleCount);
+
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        centroids[t] = (vertices[indices[t * 3]].Position + vertices[indices[t * 3 + 1]].Position + vertices[indices[t * 3 + 2]].Position) / 3.0f;
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<int> localIndex(vertices.size(), -1);
+
+    Meshlet meshlet;
+    aiVector3D centroidSum;
+    size_t nextSeed = 0;
+
+    auto newVertices = [&](size_t t)
+    {
+        int count = 0;
+
+        for (int k = 0; k < 3; k++)
+        {
+            count += localIndex[indices[t * 3 + k]] < 0;
+        }
+
+        return count;
+    };
+
+    for (size_t remaining = triangleCount; remaining > 0; remaining--)
+    {
+        /*best triangle sharing a vertex with the meshlet*/
+        UINT best = NO_TRIANGLE;
+        int bestNew = INT_MAX;
+        float bestDistance = FLT_MAX;
+        aiVector3D center = meshlet.triangleCount > 0 ? centroidSum / (float)meshlet.triangleCount : aiVector3D();
+
+        for (UINT k = 0; k < meshlet.vertexCount; k++)
+        {
+            UINT v = data.vertices[meshlet.vertexOffset + k];
+
+            for (UINT a = offsets[v]; a < offsets[v + 1]; a++)
+            {
+                UINT t = adjacency[a];
+
+                if (emitted[t])
+                {
+                    continue;
+                }
+
+                int added = newVertices(t);
+                float distance = (centroids[t] - center).SquareLength();
+
+                if (added < bestNew || (added == bestNew && distance < bestDistance))
+                {
+                    best = t;
+                    bestNew = added;
+                    bestDistance = distance;
+                }
+            }
+        }
+
+        /*continue with the next unused triangle in index order when the meshlet is enclosed or full*/
+        if (best == NO_TRIANGLE || meshlet.vertexCount + bestNew > maxVertices)
+        {
+            while (emitted[nextSeed])
+            {
+                nextSeed++;
+            }
+
+            best = (UINT)nextSeed;
+        }
+
+        if (meshlet.vertexCount + newVertices(best) > maxVertices || meshlet.triangleCount + 1 > maxTriangles)
+        {
+            for (UINT k = 0; k < meshlet.vertexCount; k++)
+            {
+                localIndex[data.vertices[meshlet.vertexOffset + k]] = -1;
+            }
+
+            finishMeshlet(data, meshlet, vertices);
+            centroidSum = aiVector3D();
+        }
+
+        for (int k = 0; k < 3; k++)
+        {
+            UINT v = indices[(size_t)best * 3 + k];
+
+            if (localIndex[v] < 0)
+            {
+                localIndex[v] = (int)meshlet.vertexCount++;
+                data.vertices.push_back(v);
+            }
+
+            data.triangles.push_back((BYTE)localIndex[v]);
+        }
+
+        meshlet.triangleCount++;
+        centroidSum += centroids[best];
+        emitted[best] = true;
+    }
+
+    if (meshlet.triangleCount > 0)
+    {
+        finishMeshlet(data, meshlet, vertices);
+    }
+
+    return data;
+}
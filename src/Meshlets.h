@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+
+#include "data.h"
+
+/*default limits, small enough for a mesh shader workgroup*/
+const size_t MESHLET_MAX_VERTICES = 64;
+const size_t MESHLET_MAX_TRIANGLES = 124;
+
+/*
+Cluster of triangles with its culling bounds. A meshlet is invisible if it
+is outside the view or if dot(normalize(coneApex - cameraPosition), coneAxis)
+>= coneCutoff, i.e. all of its triangles face away from the camera.
+*/
+struct Meshlet
+{
+    UINT vertexOffset = 0; /*first entry in MeshletData::vertices*/
+    UINT triangleOffset = 0; /*first entry in MeshletData::triangles, three per triangle*/
+    UINT vertexCount = 0;
+    UINT triangleCount = 0;
+    aiVector3D center;
+    float radius = 0.0f;
+    aiVector3D coneApex;
+    aiVector3D coneAxis;
+    float coneCutoff = 1.0f; /*1 never culls*/
+};
+
+struct MeshletData
+{
+    std::vector<Meshlet> meshlets;
+    std::vector<UINT> vertices; /*mesh vertex of every meshlet vertex*/
+    std::vector<BYTE> triangles; /*meshlet local vertex indices*/
+};
+
+/*
+Partitions a triangle list into meshlets. A meshlet grows over the triangles
+sharing its vertices, preferring triangles that add few new vertices and lie
+close to its center, and is closed once a limit would be exceeded.
+@returns Meshlets with their vertex and triangle lists
+@param Triangle list
+@param Vertices the indices refer to
+@param Maximum vertices per meshlet, at most 255
+@param Maximum triangles per meshlet, at most 255*/
+MeshletData buildMeshlets(const std::vector<UINT>& indices, const std::vector<Vertex>& vertices,
+    size_t maxVertices = MESHLET_MAX_VERTICES, size_t maxTriangles = MESHLET_MAX_TRIANGLES);
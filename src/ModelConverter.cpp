@@ -1,14 +1,98 @@
 #include "modelconverter.h"
+#include <climits>
 #include <functional>
 
 bool ModelConverter::process(const InitData& initData)
 {
-    Assimp::Importer importer;
-
     auto startTime = std::chrono::high_resolution_clock::now();
 
-    std::cout.precision(4);
-    std::cout << std::fixed;
+    out().precision(4);
+    out() << std::fixed;
+
+    /*start from an empty model, the converter can be used for many files*/
+    model = UnifiedModel();
+    stats = ConversionStats();
+    stats.fileName = initData.fileName;
+    stats.inputBytes = std::max(0LL, (long long)std::ifstream(initData.fileName, std::ios::binary | std::ios::ate).tellg());
+
+    /*interactive answers are not known up front, so only batch conversions can be cached*/
+    std::string cacheKey;
+    BuildCache cache(initData.cacheDir);
+
+    if (!initData.cacheDir.empty() && initData.batch)
+    {
+        cacheKey = BuildCache::computeKey(initData);
+    }
+
+    if (!cacheKey.empty() && restoreFromCache(initData, cache, cacheKey))
+    {
+        stats.success = true;
+        stats.cached = true;
+    }
+    else
+    {
+        stats.success = convert(initData);
+
+        if (stats.success && !cacheKey.empty() && !cache.store(cacheKey, stats.outputFiles, stats.inputFiles))
+        {
+            std::cerr << "Can not store " << initData.fileName << " in the cache " << initData.cacheDir << "!" << std::endl;
+        }
+    }
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    stats.milliseconds = std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() / 1000.0;
+
+    if (stats.success)
+    {
+        out() << (stats.cached ? "Restored " + initData.fileName + " from the cache" : "Finished processing " + model.name) << " in " << stats.milliseconds << "ms (" << stats.inputBytes / 1048576.0 << " MB read, "
+            << stats.outputBytes / 1048576.0 << " MB written to " << stats.outputFiles.size() << " file(s))." << std::endl;
+        out() << "\n===================================================\n\n";
+    }
+
+    return stats.success;
+}
+
+bool ModelConverter::restoreFromCache(const InitData& initData, const BuildCache& cache, const std::string& key)
+{
+    std::vector<std::string> fileNames;
+
+    if (!cache.lookup(key, fileNames))
+    {
+        return false;
+    }
+
+    std::error_code ec;
+
+    for (const auto& f : fileNames)
+    {
+        if (!claimOutput(outputPath(initData, f)))
+        {
+            return false;
+        }
+    }
+
+    for (const auto& f : fileNames)
+    {
+        std::string target = outputPath(initData, f);
+
+        if (!std::filesystem::copy_file(cache.entryFile(key, f), target, std::filesystem::copy_options::overwrite_existing, ec))
+        {
+            std::cerr << "Can not copy " << f << " from the cache: " << ec.message() << std::endl;
+            stats.outputBytes = 0;
+            stats.outputFiles.clear();
+            return false;
+        }
+
+        stats.outputBytes += (long long)std::filesystem::file_size(target, ec);
+        stats.outputFiles.push_back(target);
+    }
+
+    return true;
+}
+
+bool ModelConverter::convert(const InitData& initData)
+{
+    Assimp::Importer importer;
 
     /*extract base file name*/
     char id[1024];
@@ -17,35 +101,96 @@ bool ModelConverter::process(const InitData& initData)
     model.fileName = initData.prefix + id;
 
     /*load scene*/
-    const unsigned int ppsteps = aiProcess_CalcTangentSpace | // calculate tangents and bitangents if possible
-        aiProcess_JoinIdenticalVertices | // join identical vertices/ optimize indexing
-        aiProcess_ValidateDataStructure | // perform a full validation of the loader's output
-        aiProcess_ImproveCacheLocality | // improve the cache locality of the output vertices
-        aiProcess_RemoveRedundantMaterials | // remove redundant materials
-        aiProcess_FindDegenerates | // remove degenerated polygons from the import
-        aiProcess_FindInvalidData | // detect invalid model data, such as invalid normal vectors
-        aiProcess_GenUVCoords | // convert spherical, cylindrical, box and planar mapping to proper UVs
-        aiProcess_TransformUVCoords | // preprocess UV transformations (scaling, translation ...)
-        aiProcess_FindInstances | // search for instanced meshes and remove them by references to one master
-        aiProcess_LimitBoneWeights | // limit bone weights to 4 per vertex
-        aiProcess_OptimizeMeshes | // join small meshes, if possible;
-        0;
-
-    const aiScene* scene = importer.ReadFile(initData.fileName,
-                                             ppsteps | /* configurable pp steps */
-                                             aiProcess_GenSmoothNormals | // generate smooth normal vectors if not existing
-                                             aiProcess_SplitLargeMeshes | // split large, unrenderable meshes into submeshes
-                                             aiProcess_Triangulate | // triangulate polygons with more than 3 edges
-                                             aiProcess_ConvertToLeftHanded | // convert everything to D3D left handed space
-                                             aiProcess_SortByPType | // make 'clean' meshes which consist of a single typ of primitives
-                                             0);
+    unsigned int ppsteps = 0;
+
+    if (!getPostProcessPreset(initData.postProcess, ppsteps))
+    {
+        std::cerr << "Unknown post-processing preset " << initData.postProcess << "!" << std::endl;
+        return false;
+    }
+
+    /*the own optimization stage runs after pruning and transforming, assimp's would be wasted*/
+    if (initData.optimizeMeshes)
+    {
+        ppsteps &= ~aiProcess_ImproveCacheLocality;
+    }
+
+    /*keep assimp's weight limit in sync with the vertex influence slots*/
+    importer.SetPropertyInteger(AI_CONFIG_PP_LBW_MAX_WEIGHTS, MAX_BONE_INFLUENCES);
+
+    /*source files are memory mapped, the importer owns the io system*/
+    MappedIOSystem* ioSystem = new MappedIOSystem();
+    importer.SetIOHandler(ioSystem);
+
+    /*read and post-process separately to time them independently*/
+    auto importStart = std::chrono::high_resolution_clock::now();
+
+    const aiScene* scene = importer.ReadFile(initData.fileName, 0);
+
+    auto importEnd = std::chrono::high_resolution_clock::now();
+
+    stats.inputFiles = ioSystem->getOpenedFiles();
+
+    if (!scene)
+    {
+        std::cerr << "Unable to load specified file: " << initData.fileName << "! " << importer.GetErrorString() << "\n";
+        return false;
+    }
+
+    if (initData.profilePostProcess)
+    {
+        /*assimp's progress handler only reports step indices, so the steps are applied and timed one at a time*/
+        unsigned int remaining = ppsteps;
+
+        for (const auto& step : getPostProcessSteps())
+        {
+            if (!scene || !(remaining & step.flag))
+            {
+                continue;
+            }
+
+            auto stepStart = std::chrono::high_resolution_clock::now();
+            scene = importer.ApplyPostProcessing(step.flag);
+            auto stepEnd = std::chrono::high_resolution_clock::now();
+
+            stats.postProcessSteps.push_back(std::make_pair(std::string(step.name), std::chrono::duration_cast<std::chrono::microseconds>(stepEnd - stepStart).count() / 1000.0));
+            remaining &= ~step.flag;
+        }
+
+        if (scene && remaining)
+        {
+            scene = importer.ApplyPostProcessing(remaining);
+        }
+    }
+    else
+    {
+        scene = importer.ApplyPostProcessing(ppsteps);
+    }
+
+    auto postProcessEnd = std::chrono::high_resolution_clock::now();
+
+    stats.importMilliseconds = std::chrono::duration_cast<std::chrono::microseconds>(importEnd - importStart).count() / 1000.0;
+    stats.postProcessMilliseconds = std::chrono::duration_cast<std::chrono::microseconds>(postProcessEnd - importEnd).count() / 1000.0;
 
     if (!scene)
     {
-        std::cerr << "Unable to load specified file: " << initData.fileName << "!\n";
+        std::cerr << "Post-processing failed for " << initData.fileName << "! " << importer.GetErrorString() << "\n";
         return false;
     }
 
+    out() << "Imported scene in " << stats.importMilliseconds << "ms, post-processing (" << initData.postProcess << ") took " << stats.postProcessMilliseconds << "ms.\n";
+
+    /*slowest steps first*/
+    auto steps = stats.postProcessSteps;
+    std::sort(steps.begin(), steps.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+
+    for (const auto& s : steps)
+    {
+        out() << "  " << std::setw(10) << s.second << "ms  " << s.first << "\n";
+    }
+
+    out() << "\n";
+
     /*load model*/
     if (!load(scene, initData))
     {
@@ -53,32 +198,43 @@ bool ModelConverter::process(const InitData& initData)
         return false;
     }
 
-    /*write model*/
-    if (!write())
+    /*optimize meshes for the gpu*/
+    if (initData.optimizeMeshes)
+    {
+        optimizeMeshes(initData);
+    }
+
+    /*write model, the lods are written next to it*/
+    std::string baseName = model.fileName;
+
+    if (!write(initData))
     {
         std::cerr << "Failed to write model to " << model.fileName << "!" << std::endl;
         return false;
     }
 
+    if (!initData.lods.empty() && !writeLods(initData, baseName))
+    {
+        std::cerr << "Failed to write LOD " << model.fileName << "!" << std::endl;
+        return false;
+    }
+
     /*write animations*/
     if (!model.animations.empty())
     {
-        if (!writeAnimations())
+        if (!writeAnimations(initData))
         {
-            std::cout << "\n===================================================\n";
+            out() << "\n===================================================\n";
             std::cerr << "\nFailed to write animations." << std::endl;
+            return false;
         }
     }
     else
     {
-        std::cout << "\n===================================================\n";
-        std::cout << "\nNo animations to write." << std::endl;
+        out() << "\n===================================================\n";
+        out() << "\nNo animations to write." << std::endl;
     }
 
-    auto endTime = std::chrono::high_resolution_clock::now();
-    std::cout << "Finished processing file in " << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count() << "ms." << std::endl;
-    std::cout << "\n===================================================\n\n";
-
     return true;
 }
 
@@ -87,10 +243,12 @@ bool ModelConverter::load(const aiScene* scene, const InitData& initData)
     aiVector3D vMin = { +FLT_MAX, +FLT_MAX, +FLT_MAX };
     aiVector3D vMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
 
-    std::cout << initData << "\n===================================================\n\n";
+    out() << initData << "\n===================================================\n\n";
+
+    unsigned threadCount = initData.threads > 0 ? initData.threads : defaultThreadCount();
 
     model.meshes.reserve(scene->mNumMeshes);
-    std::cout << "Model contains " << scene->mNumMeshes << " mesh(es)!\n" << std::endl;
+    out() << "Model contains " << scene->mNumMeshes << " mesh(es)!\n" << std::endl;
 
     /*check for bones*/
     std::vector<UINT> totalWeight(scene->mNumMeshes);
@@ -109,7 +267,8 @@ bool ModelConverter::load(const aiScene* scene, const InitData& initData)
                 totalWeightSum[i] += fMesh->mBones[j]->mWeights[k].mWeight;
             }
 
-            if (existsBoneByName(model.bones, fMesh->mBones[j]->mName.C_Str()))
+            /*bones shared between meshes are only added once*/
+            if (!model.boneIndices.emplace(fMesh->mBones[j]->mName.C_Str(), (int)model.bones.size()).second)
             {
                 continue;
             }
@@ -118,34 +277,38 @@ bool ModelConverter::load(const aiScene* scene, const InitData& initData)
 
             b.bone = fMesh->mBones[j];
             b.name = fMesh->mBones[j]->mName.C_Str();
-            b.index = j;
+            b.index = (int)model.bones.size();
 
             model.bones.push_back(b);
         }
     }
 
     /*delete bones to force static model*/
-    if (initData.forceStatic) model.bones.clear();
+    if (initData.forceStatic)
+    {
+        model.bones.clear();
+        model.boneIndices.clear();
+    }
 
     model.isRigged = !model.bones.empty();
 
     for (UINT i = 0; i < scene->mNumMeshes; i++)
     {
-        std::cout << std::fixed << "Mesh " << scene->mMeshes[i]->mName.C_Str() << " has a total of " << totalWeight[i] << " Weights (" << totalWeightSum[i] << ")" << std::endl;
+        out() << std::fixed << "Mesh " << scene->mMeshes[i]->mName.C_Str() << " has a total of " << totalWeight[i] << " Weights (" << totalWeightSum[i] << ")" << std::endl;
     }
 
-    std::cout << "\nFound a total of " << model.bones.size() << " bones." << std::endl;
+    out() << "\nFound a total of " << model.bones.size() << " bones." << std::endl;
 
     /*print node hierarchy*/
 
     aiNode* rootNode = scene->mRootNode;
     model.rootNode = rootNode;
 
-    std::cout << "\n===================================================\n";
+    out() << "\n===================================================\n";
 
-    std::cout << "\nNode hierarchy:\n\n";
+    out() << "\nNode hierarchy:\n\n";
     printAINodes(rootNode);
-    std::cout << std::endl;
+    out() << std::endl;
 
     /*calculate bone hierarchy*/
     for (auto& b : model.bones)
@@ -154,7 +317,7 @@ bool ModelConverter::load(const aiScene* scene, const InitData& initData)
 
         if (fNode)
         {
-            b.parentIndex = findParentBone(model.bones, fNode);
+            b.parentIndex = findParentBone(model.boneIndices, fNode);
             if (b.parentIndex >= 0)
                 b.parentName = model.bones[b.parentIndex].name;
         }
@@ -166,79 +329,28 @@ bool ModelConverter::load(const aiScene* scene, const InitData& initData)
 
     for (int i = 0; i < model.bones.size(); i++)
     {
-        model.bones[i].parentIndex = findIndexInBones(model.bones, model.bones[i].parentName);
-    }
-
-    model.boneHierarchy.resize(model.bones.size());
-
-    /*find root bone and put it in first spot of the bone hierarchy*/
-    std::string rootBoneName;
-    int rootFound = 0;
-
-    for (const auto& b : model.bones)
-    {
-        if (b.parentIndex == -1)
-        {
-            model.boneHierarchy[0] = std::pair<int, int>(b.index, b.parentIndex);
-            rootBoneName = b.bone->mName.C_Str();
-            rootFound++;
-        }
-    }
-
-    if (rootFound != 1 && model.isRigged)
-    {
-        std::cerr << "Can not find root bone or there are more than one root bone!" << std::endl;
-        return false;
+        model.bones[i].parentIndex = findIndexInBones(model.boneIndices, model.bones[i].parentName);
     }
 
     if (model.isRigged)
     {
-        int bonesUsed = 1;
-
-        while (bonesUsed != model.bones.size())
-        {
-            for (auto& b : model.bones)
-            {
-                if (!b.used)
-                {
-                    if (isInHierarchy(b.parentIndex, model.boneHierarchy))
-                    {
-                        model.boneHierarchy[bonesUsed] = std::pair<int, int>(b.index, b.parentIndex);
-                        b.used = true;
-                        bonesUsed++;
-                    }
-                }
-            }
-        }
-
-        /*test if bone hierarchy is correct*/
-        std::vector<int> testHierarchy;
-        testHierarchy.push_back(-1);
-
-        for (const auto& v : model.boneHierarchy)
+        if (!buildBoneHierarchy(model.bones, model.boneHierarchy))
         {
-            if (isInVector(testHierarchy, v.second))
-            {
-                testHierarchy.push_back(v.first);
-            }
-            else
-            {
-                std::cerr << "Bone hierarchy error!\n";
-                return false;
-            }
+            return false;
         }
 
-        std::cout << "Bone hierarchy test successful.\n";
+        out() << "Bone hierarchy test successful.\n";
     }
 
-    std::cout << "\n===================================================\n\n";
+    out() << "\n===================================================\n\n";
 
     /*load animation*/
 
     if (model.isRigged)
     {
         model.animations.resize(scene->mNumAnimations);
-        std::cout << "\n";
+        SimdLevel simdLevel = detectSimdLevel();
+        out() << "\n";
 
         for (UINT k = 0; k < scene->mNumAnimations; k++)
         {
@@ -254,9 +366,10 @@ bool ModelConverter::load(const aiScene* scene, const InitData& initData)
             /*get rid of | character*/
             std::replace(model.animations[k].name.begin(), model.animations[k].name.end(), '|', '_');
 
-            std::cout << "Animation " << model.animations[k].name << ": " << anim->mDuration / anim->mTicksPerSecond << "s (" << anim->mTicksPerSecond << " tick rate) animates " << anim->mNumChannels << " nodes.\n";
+            out() << "Animation " << model.animations[k].name << ": " << anim->mDuration / anim->mTicksPerSecond << "s (" << anim->mTicksPerSecond << " tick rate) animates " << anim->mNumChannels << " nodes.\n";
 
             model.animations[k].keyframes.resize(model.bones.size());
+            model.animations[k].channels.resize(model.bones.size());
 
             for (UINT p = 0; p < anim->mNumChannels; p++)
             {
@@ -264,55 +377,65 @@ bool ModelConverter::load(const aiScene* scene, const InitData& initData)
 
                 /*figure out how many keyframes*/
                 int numKeyFrames = std::max(channel->mNumPositionKeys, channel->mNumRotationKeys);
-                int nodeIndex = findIndexInBones(model.bones, channel->mNodeName.C_Str());
+                int nodeIndex = findIndexInBones(model.boneIndices, channel->mNodeName.C_Str());
                 if (nodeIndex < 0) continue;
 
+                /*channels keep their own key times*/
+                BoneChannels& boneChannels = model.animations[k].channels[nodeIndex];
+                boneChannels = BoneChannels();
+
+                for (UINT m = 0; m < channel->mNumPositionKeys; m++)
+                {
+                    boneChannels.translation.push_back({ (float)(channel->mPositionKeys[m].mTime / animTicks), channel->mPositionKeys[m].mValue });
+                }
+
+                for (UINT m = 0; m < channel->mNumRotationKeys; m++)
+                {
+                    boneChannels.rotation.push_back({ (float)(channel->mRotationKeys[m].mTime / animTicks), channel->mRotationKeys[m].mValue });
+                }
+
+                for (UINT m = 0; m < channel->mNumScalingKeys; m++)
+                {
+                    boneChannels.scale.push_back({ (float)(channel->mScalingKeys[m].mTime / animTicks), channel->mScalingKeys[m].mValue });
+                }
+
                 model.animations[k].keyframes[nodeIndex].resize(numKeyFrames);
 
                 for (int m = 0; m < numKeyFrames; m++)
                 {
                     KeyFrame keyFrame;
 
-                    /*figuring out the correct timestamp because assimp is weird*/
-                    keyFrame.timeStamp = (float)channel->mPositionKeys[m].mTime / animTicks;
+                    /*figuring out the correct timestamp because assimp is weird, only channels that have key m are asked*/
+                    bool hasPosition = m < (int)channel->mNumPositionKeys;
+                    bool hasRotation = m < (int)channel->mNumRotationKeys;
+
+                    keyFrame.timeStamp = hasPosition ? (float)channel->mPositionKeys[m].mTime / animTicks : 0.0f;
 
                     if (m > 0 && (keyFrame.timeStamp - 0.0001f) <= 0.0f)
                     {
-                        keyFrame.timeStamp = (float)channel->mRotationKeys[m].mTime / animTicks;
+                        keyFrame.timeStamp = hasRotation ? (float)channel->mRotationKeys[m].mTime / animTicks : 0.0f;
 
                         if ((keyFrame.timeStamp - 0.0001f) <= 0.0f)
                         {
-                            std::cout << "Warning: Timing on key frame " << m << " is 0!\n";
+                            out() << "Warning: Timing on key frame " << m << " is 0!\n";
                         }
                     }
 
-                    /*keep data from previous keyframe if there are no new data points
-                    */
-                    if (m >= (int)channel->mNumRotationKeys)
-                    {
-                        keyFrame.rotationQuat = channel->mRotationKeys[channel->mNumRotationKeys - 1].mValue;
-                    }
-                    else
+                    /*keep data from previous keyframe if there are no new data points,
+                    channels without any keys keep the defaults*/
+                    if (channel->mNumRotationKeys > 0)
                     {
-                        keyFrame.rotationQuat = channel->mRotationKeys[m].mValue;
+                        keyFrame.rotationQuat = channel->mRotationKeys[std::min(m, (int)channel->mNumRotationKeys - 1)].mValue;
                     }
 
-                    if (m >= (int)channel->mNumPositionKeys)
+                    if (channel->mNumPositionKeys > 0)
                     {
-                        keyFrame.translation = channel->mPositionKeys[channel->mNumPositionKeys - 1].mValue;
-                    }
-                    else
-                    {
-                        keyFrame.translation = channel->mPositionKeys[m].mValue;
+                        keyFrame.translation = channel->mPositionKeys[std::min(m, (int)channel->mNumPositionKeys - 1)].mValue;
                     }
 
-                    if (m >= (int)channel->mNumScalingKeys)
-                    {
-                        keyFrame.scale = channel->mScalingKeys[channel->mNumScalingKeys - 1].mValue;
-                    }
-                    else
+                    if (channel->mNumScalingKeys > 0)
                     {
-                        keyFrame.scale = channel->mScalingKeys[m].mValue;
+                        keyFrame.scale = channel->mScalingKeys[std::min(m, (int)channel->mNumScalingKeys - 1)].mValue;
                     }
 
                     model.animations[k].keyframes[nodeIndex][m] = keyFrame;
@@ -329,38 +452,108 @@ bool ModelConverter::load(const aiScene* scene, const InitData& initData)
                 }
             }
 
-            std::cout << "\n---------------------------------------------------\n\n";
+            if (initData.bakeRate > 0.0f)
+            {
+                size_t frames = bakeAnimation(model.animations[k], initData.bakeRate, simdLevel);
+                out() << "Baked " << frames << " frames at " << initData.bakeRate << " Hz (" << getSimdLevelName(simdLevel) << ").\n";
+            }
+
+            out() << "\n---------------------------------------------------\n\n";
         }
     }
 
-    std::cout << std::endl;
+    out() << std::endl;
+
+    /*load meshes, questions are asked up front so the extraction can run in parallel*/
+    std::vector<UINT> meshSources;
 
-    /*load meshes*/
     for (UINT j = 0; j < scene->mNumMeshes; j++)
     {
         aiMesh* mesh = scene->mMeshes[j];
+        UnifiedMesh unifiedMesh;
 
-        /*reserve memory for vertices*/
-        model.meshes.push_back(UnifiedMesh());
-        model.meshes[j].vertices.reserve(mesh->mNumVertices);
-
-        std::cout << "Mesh " << j << " (" << mesh->mName.C_Str() << ") has " << mesh->mNumVertices << " vertices and " << mesh->mNumFaces << " faces.\n" << std::endl;
+        out() << "Mesh " << j << " (" << mesh->mName.C_Str() << ") has " << mesh->mNumVertices << " vertices and " << mesh->mNumFaces << " faces.\n" << std::endl;
 
-        std::cout << "Input name of material for " << mesh->mName.C_Str() << ": ";
-        std::getline(std::cin, model.meshes[j].materialName);
+        unifiedMesh.materialName = ask("Input name of material for " + std::string(mesh->mName.C_Str()) + ": ", initData.batch, initData.materials, mesh->mName.C_Str());
 
-        if (j > 0 && model.meshes[j].materialName == "")
+        if (!model.meshes.empty() && unifiedMesh.materialName == "")
         {
-            model.meshes[j].materialName = model.meshes[(INT_PTR)j - 1].materialName;
+            unifiedMesh.materialName = model.meshes.back().materialName;
         }
 
-        if (model.meshes[j].materialName == "del")
+        if (unifiedMesh.materialName == "del")
         {
-            model.meshes.pop_back();
             continue;
         }
 
+        /*load transformation from node*/
+        aiNode* trfNode = scene->mRootNode->FindNode(mesh->mName.C_Str());
+
+        if (trfNode)
+        {
+            unifiedMesh.rootTransform = getGlobalTransform(trfNode);
+        }
+        else
+        {
+            out() << "\nCouldn't find the associated node!\n";
+            unifiedMesh.rootTransform = aiMatrix4x4();
+
+            /*batch mode can name any node of the tree*/
+            aiNode* fallbackNode = initData.fallbackNode.empty() ? nullptr : scene->mRootNode->FindNode(initData.fallbackNode.c_str());
+
+            if (fallbackNode)
+            {
+                out() << "Using node \"" << initData.fallbackNode << "\" instead.\n";
+                unifiedMesh.rootTransform = getGlobalTransform(fallbackNode);
+            }
+
+            for (int i = 0; i < (int)scene->mRootNode->mNumChildren && !fallbackNode; i++)
+            {
+                std::string nodeName = scene->mRootNode->mChildren[i]->mName.C_Str();
+                std::string userInput;
+
+                out() << "Do you want to use node \"" << scene->mRootNode->mChildren[i]->mName.C_Str() << "\" instead? (y/n)\n";
+
+                if (initData.batch)
+                {
+                    userInput = initData.fallbackNode.empty() ? "y" : "n";
+                    out() << userInput << "\n";
+                }
+                else
+                {
+                    std::getline(std::cin, userInput);
+                }
+
+                if (userInput == "y" || userInput == "yes" || userInput.empty())
+                {
+                    unifiedMesh.rootTransform = getGlobalTransform(scene->mRootNode->mChildren[i]);
+                    break;
+                }
+            }
+        }
+
+        if (unifiedMesh.rootTransform.IsIdentity())
+        {
+            out() << "Root transform = Identity matrix\n";
+        }
+
+        out() << "\n---------------------------------------------------\n\n";
+
+        model.meshes.push_back(std::move(unifiedMesh));
+        meshSources.push_back(j);
+    }
+
+    /*get vertices and indices, every task only touches its own mesh and bounds*/
+    std::vector<aiVector3D> meshMin(model.meshes.size(), vMin);
+    std::vector<aiVector3D> meshMax(model.meshes.size(), vMax);
+
+    parallelFor(model.meshes.size(), threadCount, [&](size_t m, unsigned)
+    {
+        const aiMesh* mesh = scene->mMeshes[meshSources[m]];
+        UnifiedMesh& unifiedMesh = model.meshes[m];
+
         /*get vertices: positions normals tex coords and tangentu */
+        unifiedMesh.vertices.resize(mesh->mNumVertices);
 
         for (UINT v = 0; v < mesh->mNumVertices; v++)
         {
@@ -380,106 +573,107 @@ bool ModelConverter::load(const aiScene* scene, const InitData& initData)
             }
 
             /*convert to vertex data format*/
-            model.meshes[j].vertices.push_back(Vertex(pos, tex, norm, tangU));
+            unifiedMesh.vertices[v] = Vertex(pos, tex, norm, tangU);
 
-            if (pos < vMin)
+            if (pos < meshMin[m])
             {
-                vMin = pos;
+                meshMin[m] = pos;
             }
 
-            if (vMax < pos)
+            if (meshMax[m] < pos)
             {
-                vMax = pos;
+                meshMax[m] = pos;
             }
         }
 
-        /*load transformation from node*/
-        aiNode* trfNode = scene->mRootNode->FindNode(mesh->mName.C_Str());
+        /*get indices*/
+        unifiedMesh.indices.resize((size_t)mesh->mNumFaces * 3);
 
-        if (trfNode)
-        {
-            model.meshes[j].rootTransform = getGlobalTransform(trfNode);
-        }
-        else
+        for (UINT k = 0; k < mesh->mNumFaces; k++)
         {
-            std::cout << "\nCouldn't find the associated node!\n";
-            model.meshes[j].rootTransform = aiMatrix4x4();
-
-            for (int i = 0; i < (int)scene->mRootNode->mNumChildren; i++)
-            {
-                std::string nodeName = scene->mRootNode->mChildren[i]->mName.C_Str();
-                std::string userInput;
-
-                std::cout << "Do you want to use node \"" << scene->mRootNode->mChildren[i]->mName.C_Str() << "\" instead? (y/n)\n";
-                std::getline(std::cin, userInput);
-
-                if (userInput == "y" || userInput == "yes" || userInput.empty())
-                {
-                    model.meshes[j].rootTransform = getGlobalTransform(scene->mRootNode->mChildren[i]);
-                    break;;
-                }
-            }
+            unifiedMesh.indices[(size_t)k * 3 + 0] = mesh->mFaces[k].mIndices[0];
+            unifiedMesh.indices[(size_t)k * 3 + 1] = mesh->mFaces[k].mIndices[1];
+            unifiedMesh.indices[(size_t)k * 3 + 2] = mesh->mFaces[k].mIndices[2];
         }
+    });
 
-        if (model.meshes[j].rootTransform.IsIdentity())
+    /*merge the bounds of all meshes*/
+    for (size_t m = 0; m < model.meshes.size(); m++)
+    {
+        if (meshMin[m] < vMin)
         {
-            std::cout << "Root transform = Identity matrix\n";
+            vMin = meshMin[m];
         }
 
-        std::cout << "\n---------------------------------------------------\n\n";
-
-        /*get indices*/
-        model.meshes[j].indices.reserve((long long)(mesh->mNumFaces) * 3);
-
-        for (UINT k = 0; k < mesh->mNumFaces; k++)
+        if (vMax < meshMax[m])
         {
-            model.meshes[j].indices.push_back(mesh->mFaces[k].mIndices[0]);
-            model.meshes[j].indices.push_back(mesh->mFaces[k].mIndices[1]);
-            model.meshes[j].indices.push_back(mesh->mFaces[k].mIndices[2]);
+            vMax = meshMax[m];
         }
     }
 
     /*add weights*/
     if (model.isRigged)
     {
-        /*add weights from bones to vertices*/
-        for (const auto& b : model.bones)
+        /*add weights from the bones of every mesh to its own vertices, influences beyond the slot capacity are dropped*/
+        std::vector<UINT> droppedInfluences(model.meshes.size(), 0);
+        std::vector<UINT> overweightVertices(model.meshes.size(), 0);
+
+        parallelFor(model.meshes.size(), threadCount, [&](size_t m, unsigned)
         {
-            for (UINT k = 0; k < b.bone->mNumWeights; k++)
+            const aiMesh* mesh = scene->mMeshes[meshSources[m]];
+            UnifiedMesh& unifiedMesh = model.meshes[m];
+
+            for (UINT j = 0; j < mesh->mNumBones; j++)
             {
-                model.meshes[0].vertices[b.bone->mWeights[k].mVertexId].BlendIndices.push_back(b.index);
-                model.meshes[0].vertices[b.bone->mWeights[k].mVertexId].BlendWeights.push_back(b.bone->mWeights[k].mWeight);
+                const aiBone* bone = mesh->mBones[j];
+                int index = findIndexInBones(model.boneIndices, bone->mName.C_Str());
+
+                for (UINT k = 0; k < bone->mNumWeights; k++)
+                {
+                    if (!unifiedMesh.vertices[bone->mWeights[k].mVertexId].addInfluence((UINT)index, bone->mWeights[k].mWeight))
+                    {
+                        droppedInfluences[m]++;
+                    }
+                }
             }
-        }
 
-        /*check weight validity*/
-        for (auto& v : model.meshes[0].vertices)
-        {
-            if (v.BlendIndices.size() > 4)
+            /*check weight validity*/
+            for (auto& v : unifiedMesh.vertices)
             {
-                std::cout << "Illegal amount of blend indices!" << std::endl;
-            }
+                float acc = 0.0f;
 
-            float acc = 0.0f;
+                for (BYTE k = 0; k < v.NumInfluences; k++)
+                {
+                    acc += v.BlendWeights[k];
+                }
 
-            for (const auto& f : v.BlendWeights)
-            {
-                acc += f;
+                if (acc > 1.01f)
+                {
+                    overweightVertices[m]++;
+                }
+
+                if (acc < 1.0f)
+                {
+                    float add = (1.0f - acc) / 4.0f;
+
+                    for (BYTE k = 0; k < v.NumInfluences; k++)
+                    {
+                        v.BlendWeights[k] += add;
+                    }
+                }
             }
+        });
 
-            if (acc > 1.01f)
+        for (size_t m = 0; m < model.meshes.size(); m++)
+        {
+            if (droppedInfluences[m] > 0)
             {
-                std::cout << "Blend Weight sum over 1! " << acc << std::endl;
+                out() << "Illegal amount of blend indices in mesh " << m << "! Dropped " << droppedInfluences[m] << " influences." << std::endl;
             }
 
-            if (acc < 1.0f)
+            if (overweightVertices[m] > 0)
             {
-                float add = (1.0f - acc) / 4.0f;
-
-                for (auto& f : v.BlendWeights)
-                {
-                    f += add;
-                }
+                out() << "Blend Weight sum over 1 for " << overweightVertices[m] << " vertices of mesh " << m << "!" << std::endl;
             }
         }
     }
@@ -490,44 +684,186 @@ bool ModelConverter::load(const aiScene* scene, const InitData& initData)
 
     if (initData.centerEnabled && !model.isRigged)
     {
-        std::cout << "\nCentering at " << center.x << " | " << center.y << " | " << center.z << ".." << std::endl;
+        out() << "\nCentering at " << center.x << " | " << center.y << " | " << center.z << ".." << std::endl;
     }
     if (initData.scaleFactor != 1.0f)
     {
-        std::cout << "Scaling with factor " << initData.scaleFactor << ".." << std::endl;
+        out() << "Scaling with factor " << initData.scaleFactor << ".." << std::endl;
     }
 
-    for (auto& m : model.meshes)
+    /*center, scale and root transform are fused into one affine transform per mesh*/
+    bool applyCenter = initData.centerEnabled && !model.isRigged;
+    bool applyRoot = !model.isRigged || initData.forceTransform;
+    SimdLevel simdLevel = detectSimdLevel();
+
+    parallelFor(model.meshes.size(), threadCount, [&](size_t i, unsigned)
     {
-        for (auto& v : m.vertices)
+        UnifiedMesh& m = model.meshes[i];
+
+        VertexTransform transform = makeVertexTransform(applyCenter ? center : aiVector3D(), initData.scaleFactor, m.rootTransform, applyRoot);
+        transformVertices(m.vertices.data(), m.vertices.size(), transform, simdLevel);
+    });
+
+    /*meshes referencing more bones than a palette holds are split*/
+    if (model.isRigged && initData.bonePaletteSize > 0)
+    {
+        std::vector<std::vector<UnifiedMesh>> parts(model.meshes.size());
+
+        parallelFor(model.meshes.size(), threadCount, [&](size_t i, unsigned)
         {
-            if (initData.centerEnabled && !model.isRigged)
+            parts[i] = splitByBonePalette(model.meshes[i], initData.bonePaletteSize);
+        });
+
+        model.meshes.clear();
+        out() << "\nBone palettes of at most " << initData.bonePaletteSize << " bones:\n";
+
+        for (size_t i = 0; i < parts.size(); i++)
+        {
+            out() << "Mesh " << i << ":";
+
+            for (auto& p : parts[i])
             {
-                v.Position -= center;
+                out() << " " << p.bonePalette.size();
+                model.meshes.push_back(std::move(p));
             }
 
-            if (initData.scaleFactor != 1.0f)
-            {
-                v.Position *= initData.scaleFactor;
-            }
+            out() << (parts[i].size() > 1 ? " bones after splitting\n" : " bones\n");
+        }
+    }
+
+    out() << "\nFinished loading file.\n";
+    out() << "\n===================================================\n\n";
+
+    return true;
+}
+
+void ModelConverter::optimizeMeshes(const InitData& initData)
+{
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    unsigned threadCount = initData.threads > 0 ? initData.threads : defaultThreadCount();
+
+    std::vector<VertexCacheStats> before(model.meshes.size());
+    std::vector<VertexCacheStats> after(model.meshes.size());
+    std::vector<size_t> dropped(model.meshes.size());
+
+    parallelFor(model.meshes.size(), threadCount, [&](size_t i, unsigned)
+    {
+        UnifiedMesh& m = model.meshes[i];
+
+        before[i] = analyzeVertexCache(m.indices, m.vertices.size());
+
+        /*triangle order for the vertex cache, then clusters for overdraw, then vertices in fetch order*/
+        optimizeVertexCache(m.indices, m.vertices.size());
+        optimizeOverdraw(m.indices, m.vertices);
+        dropped[i] = optimizeVertexFetch(m.vertices, m.indices);
+
+        after[i] = analyzeVertexCache(m.indices, m.vertices.size());
+    });
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+
+    out() << "Optimized meshes in " << std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() / 1000.0 << "ms (ACMR/ATVR with a 16 entry FIFO cache):\n";
+
+    for (size_t i = 0; i < model.meshes.size(); i++)
+    {
+        out() << "Mesh " << i << ": ACMR " << before[i].acmr << " -> " << after[i].acmr << ", ATVR " << before[i].atvr << " -> " << after[i].atvr;
+
+        if (dropped[i] > 0)
+        {
+            out() << ", dropped " << dropped[i] << " unused vertices";
+        }
+
+        out() << "\n";
+    }
+
+    out() << "\n===================================================\n\n";
+}
+
+bool ModelConverter::writeLods(const InitData& initData, const std::string& baseName)
+{
+    unsigned threadCount = initData.threads > 0 ? initData.threads : defaultThreadCount();
+
+    /*ratios refer to the full mesh, every level is simplified from the previous one*/
+    std::vector<size_t> triangleCounts(model.meshes.size());
+
+    for (size_t i = 0; i < model.meshes.size(); i++)
+    {
+        triangleCounts[i] = model.meshes[i].indices.size() / 3;
+    }
+
+    for (size_t level = 0; level < initData.lods.size(); level++)
+    {
+        auto startTime = std::chrono::high_resolution_clock::now();
+
+        std::vector<size_t> before(model.meshes.size());
+        std::vector<float> errors(model.meshes.size());
 
-            if (!model.isRigged || initData.forceTransform)
+        parallelFor(model.meshes.size(), threadCount, [&](size_t i, unsigned)
+        {
+            UnifiedMesh& m = model.meshes[i];
+            size_t targetTriangles = std::max((size_t)(triangleCounts[i] * initData.lods[level]), (size_t)1);
+
+            before[i] = m.indices.size() / 3;
+            errors[i] = simplifyMesh(m.indices, m.vertices, targetTriangles * 3);
+
+            /*the collapsed vertices are no longer referenced, the fetch optimization drops them*/
+            if (initData.optimizeMeshes)
             {
-                v.Position = m.rootTransform * v.Position;
-                v.Normal = m.rootTransform * v.Normal;
-                v.TangentU = m.rootTransform * v.TangentU;
+                optimizeVertexCache(m.indices, m.vertices.size());
+                optimizeOverdraw(m.indices, m.vertices);
             }
+
+            optimizeVertexFetch(m.vertices, m.indices);
+        });
+
+        auto endTime = std::chrono::high_resolution_clock::now();
+
+        out() << "\nSimplified LOD " << level + 1 << " (" << initData.lods[level] * 100.0f << "% of the triangles) in "
+            << std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() / 1000.0 << "ms:\n";
+
+        for (size_t i = 0; i < model.meshes.size(); i++)
+        {
+            out() << "Mesh " << i << ": " << before[i] << " -> " << model.meshes[i].indices.size() / 3 << " triangles, "
+                << model.meshes[i].vertices.size() << " vertices, error " << errors[i] * 100.0f << "% of the extent\n";
+        }
+
+        model.fileName = baseName + "_lod" + std::to_string(level + 1);
+
+        if (!write(initData))
+        {
+            return false;
         }
     }
 
-    std::cout << "\nFinished loading file.\n";
-    std::cout << "\n===================================================\n\n";
+    out() << "\n===================================================\n\n";
 
     return true;
 }
 
-bool ModelConverter::write()
+bool ModelConverter::write(const InitData& initData)
 {
+    /*quantized bone indices are single bytes, with bone palettes they index the palette of their mesh*/
+    bool bonePalettes = model.isRigged && initData.bonePaletteSize > 0;
+    size_t indexedBones = model.bones.size();
+
+    if (bonePalettes)
+    {
+        indexedBones = 0;
+
+        for (const auto& m : model.meshes)
+        {
+            indexedBones = std::max(indexedBones, m.bonePalette.size());
+        }
+    }
+
+    /*checked before the file is opened, so a rejected model leaves no empty file behind*/
+    if (initData.quantize && indexedBones > 256)
+    {
+        std::cerr << "Quantized vertices support at most 256 bones" << (bonePalettes ? " per palette, the largest palette has " : ", the model has ") << indexedBones << "!" << std::endl;
+        return false;
+    }
+
     if (model.isRigged)
     {
         model.fileName += ".s3d";
@@ -537,9 +873,14 @@ bool ModelConverter::write()
         model.fileName += ".b3d";
     }
 
-    std::ios_base::sync_with_stdio(false);
-    std::cin.tie(NULL);
+    model.fileName = outputPath(initData, model.fileName);
+
+    if (!claimOutput(model.fileName))
+    {
+        return false;
+    }
 
+    auto startTime = std::chrono::high_resolution_clock::now();
     auto fileHandle = std::fstream(model.fileName, std::ios::out | std::ios::binary);
 
     if (!fileHandle.is_open())
@@ -547,58 +888,140 @@ bool ModelConverter::write()
         return false;
     }
 
-    /*header*/
-    if (model.isRigged)
+    /*header, the extended header records the vertex and index encoding*/
+    UINT formatFlags = (initData.quantize ? FORMAT_QUANTIZED : 0) | (initData.shortIndices ? FORMAT_INDEX_WIDTH : 0) | (initData.meshlets ? FORMAT_MESHLETS : 0) |
+        (bonePalettes ? FORMAT_BONE_PALETTES : 0);
+
+    /*the plain format only takes byte counts, larger models always use the sectioned format*/
+    bool fitsPlainFormat = model.meshes.size() <= PLAIN_FORMAT_MAX_MESHES && model.bones.size() <= PLAIN_FORMAT_MAX_BONES;
+
+    if (formatFlags == 0 && !fitsPlainFormat)
     {
-        char header[4] = { 0x73, 0x33, 0x64, 0x66 };
-        fileHandle.write(header, 4);
+        out() << "The model has more than " << PLAIN_FORMAT_MAX_MESHES << " meshes or " << PLAIN_FORMAT_MAX_BONES << " bones, writing the sectioned format.\n";
+    }
+
+    bool sectioned = formatFlags != 0 || !fitsPlainFormat;
+    std::vector<SectionRecord> sections;
+    std::streamoff sectionTableOffset = 0;
+
+    if (sectioned)
+    {
+        ExtendedHeaderRecord header = { SECTIONED_FORMAT_VERSION, formatFlags };
+
+        fileHandle.write(model.isRigged ? S3D_EXTENDED_MAGIC : B3D_EXTENDED_MAGIC, 4);
+        fileHandle.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        /*section table, filled in once all sections are written*/
+        UINT sectionCount = model.isRigged ? 5 : 2;
+        std::vector<SectionRecord> emptyTable(sectionCount, SectionRecord{});
+
+        fileHandle.write(reinterpret_cast<const char*>(&sectionCount), sizeof(UINT));
+        sectionTableOffset = fileHandle.tellp();
+        fileHandle.write(reinterpret_cast<const char*>(emptyTable.data()), sizeof(SectionRecord) * sectionCount);
     }
     else
     {
-        char header[4] = { 0x62, 0x33, 0x64, 0x66 };
-        fileHandle.write(header, 4);
+        fileHandle.write(model.isRigged ? S3D_MAGIC : B3D_MAGIC, 4);
     }
 
+    auto beginSection = [&](UINT type)
+    {
+        if (sectioned)
+        {
+            sections.push_back({ type, (uint64_t)fileHandle.tellp(), 0 });
+        }
+    };
+
+    auto endSection = [&]()
+    {
+        if (sectioned)
+        {
+            sections.back().Size = (uint64_t)fileHandle.tellp() - sections.back().Offset;
+        }
+    };
+
+    /*counts and bone ids, a byte in the plain format*/
+    auto writeCount = [&](size_t count)
+    {
+        if (sectioned)
+        {
+            UINT value = (UINT)count;
+            fileHandle.write(reinterpret_cast<const char*>(&value), sizeof(UINT));
+        }
+        else
+        {
+            BYTE value = (BYTE)count;
+            fileHandle.write(reinterpret_cast<const char*>(&value), sizeof(BYTE));
+        }
+    };
+
+    /*names, with a 16 bit length in the plain format*/
+    auto writeString = [&](const char* str, size_t size)
+    {
+        if (sectioned)
+        {
+            UINT length = (UINT)size;
+            fileHandle.write(reinterpret_cast<const char*>(&length), sizeof(UINT));
+        }
+        else
+        {
+            size = std::min(size, (size_t)SHRT_MAX);
+            short length = (short)size;
+            fileHandle.write(reinterpret_cast<const char*>(&length), sizeof(short));
+        }
+
+        fileHandle.write(str, size);
+    };
+
     /*bone data only in s3d*/
     if (model.isRigged)
     {
+        beginSection(SECTION_BONES);
+
         /*number of bones*/
-        char boneSize = (char)model.bones.size();
-        fileHandle.write(reinterpret_cast<const char*>(&boneSize), sizeof(char));
+        writeCount(model.bones.size());
 
         for (const auto& b : model.bones)
         {
             /*bone id*/
-            char boneID = (char)b.index;
-            fileHandle.write(reinterpret_cast<const char*>(&boneID), sizeof(char));
+            writeCount((size_t)b.index);
 
             /*bone name*/
-            short boneStrSize = (short)b.name.size();
-            fileHandle.write(reinterpret_cast<const char*>(&boneStrSize), sizeof(boneStrSize));
-            fileHandle.write(reinterpret_cast<const char*>(&b.name[0]), boneStrSize);
+            writeString(b.name.c_str(), b.name.size());
+
+            aiMatrix4x4 offsetMatrix = b.bone->mOffsetMatrix;
+            fileHandle.write(reinterpret_cast<const char*>(&offsetMatrix.Transpose()), sizeof(aiMatrix4x4));
+        }
 
-            fileHandle.write(reinterpret_cast<const char*>(&b.bone->mOffsetMatrix.Transpose()), sizeof(aiMatrix4x4));
+        endSection();
+        beginSection(SECTION_BONE_HIERARCHY);
+
+        /*bone hierarchy pairs, the plain format has one per bone*/
+        if (sectioned)
+        {
+            writeCount(model.boneHierarchy.size());
         }
 
-        /*bone hierarchy pairs*/
         for (const auto& b : model.boneHierarchy)
         {
             fileHandle.write(reinterpret_cast<const char*>(&b.first), sizeof(int));
             fileHandle.write(reinterpret_cast<const char*>(&b.second), sizeof(int));
         }
 
+        endSection();
+        beginSection(SECTION_NODES);
+
         /*complete node tree*/
         std::function<void(aiNode*, int)> writeTree = [&](aiNode* node, int depth) -> void
         {
-            std::cout << std::string((long long)depth * 2, ' ') << ">> writing " << node->mName.C_Str() << "\n";
+            out() << std::string((long long)depth * 2, ' ') << ">> writing " << node->mName.C_Str() << "\n";
 
             /*name*/
-            short nodeNameSize = (short)node->mName.length;
-            fileHandle.write(reinterpret_cast<const char*>(&nodeNameSize), sizeof(nodeNameSize));
-            fileHandle.write(reinterpret_cast<const char*>(&node->mName.C_Str()[0]), nodeNameSize);
+            writeString(node->mName.C_Str(), node->mName.length);
 
             /*transform*/
-            fileHandle.write(reinterpret_cast<const char*>(&node->mTransformation.Transpose()), sizeof(aiMatrix4x4));
+            aiMatrix4x4 transform = node->mTransformation;
+            fileHandle.write(reinterpret_cast<const char*>(&transform.Transpose()), sizeof(aiMatrix4x4));
 
             /*number of children*/
             fileHandle.write(reinterpret_cast<const char*>(&node->mNumChildren), sizeof(unsigned int));
@@ -610,85 +1033,237 @@ bool ModelConverter::write()
         };
 
         writeTree(model.rootNode, 0);
+        endSection();
     }
 
     /*mesh data for both formats*/
+    beginSection(SECTION_MESHES);
 
     /*number of meshes*/
-    char meshSize = (char)model.meshes.size();
-    fileHandle.write(reinterpret_cast<const char*>(&meshSize), sizeof(char));
+    size_t meshSize = model.meshes.size();
+    writeCount(meshSize);
 
-    for (char i = 0; i < meshSize; i++)
+    /*meshlets of all meshes are built up front, the meshes are independent*/
+    std::vector<MeshletData> meshlets(initData.meshlets ? model.meshes.size() : 0);
+
+    if (initData.meshlets)
     {
+        auto meshletStart = std::chrono::high_resolution_clock::now();
+
+        parallelFor(meshlets.size(), initData.threads > 0 ? initData.threads : defaultThreadCount(), [&](size_t i, unsigned)
+        {
+            meshlets[i] = buildMeshlets(model.meshes[i].indices, model.meshes[i].vertices);
+        });
+
+        auto meshletEnd = std::chrono::high_resolution_clock::now();
+
+        out() << "Built meshlets in " << std::chrono::duration_cast<std::chrono::microseconds>(meshletEnd - meshletStart).count() / 1000.0 << "ms:\n";
+
+        for (size_t i = 0; i < meshlets.size(); i++)
+        {
+            size_t count = meshlets[i].meshlets.size();
+
+            out() << "Mesh " << i << ": " << count << " meshlets";
+
+            if (count > 0)
+            {
+                out() << ", " << meshlets[i].vertices.size() / (float)count << " vertices and "
+                    << meshlets[i].triangles.size() / 3.0f / count << " triangles on average";
+            }
+
+            out() << "\n";
+        }
+    }
+
+    /*vertex streams are reused across meshes*/
+    std::vector<StaticVertexRecord> staticRecords;
+    std::vector<SkinnedVertexRecord> skinnedRecords;
+    std::vector<QuantizedStaticVertexRecord> quantizedStaticRecords;
+    std::vector<QuantizedSkinnedVertexRecord> quantizedSkinnedRecords;
+    std::vector<uint16_t> shortIndexRecords;
+    std::vector<MeshletRecord> meshletRecords;
+    std::vector<MeshIndexRecord> meshIndex(meshSize);
+
+    for (size_t i = 0; i < meshSize; i++)
+    {
+        meshIndex[i].Offset = (uint64_t)fileHandle.tellp();
+
+        if (bonePalettes)
+        {
+            UINT paletteSize = (UINT)model.meshes[i].bonePalette.size();
+            fileHandle.write(reinterpret_cast<const char*>(&paletteSize), sizeof(UINT));
+            fileHandle.write(reinterpret_cast<const char*>(model.meshes[i].bonePalette.data()), sizeof(UINT) * paletteSize);
+        }
+
         /*material name*/
-        short stringSize = (short)model.meshes[i].materialName.size();
-        fileHandle.write(reinterpret_cast<const char*>(&stringSize), sizeof(stringSize));
-        fileHandle.write(reinterpret_cast<const char*>(&model.meshes[i].materialName[0]), stringSize);
+        writeString(model.meshes[i].materialName.c_str(), model.meshes[i].materialName.size());
 
         /*num vertices*/
         int verticesSize = (int)model.meshes[i].vertices.size();
         fileHandle.write(reinterpret_cast<const char*>(&verticesSize), sizeof(int));
 
-        /*vertices*/
-        for (int v = 0; v < verticesSize; v++)
-        {
-            /*position*/
-            fileHandle.write(reinterpret_cast<const char*>(&model.meshes[i].vertices[v].Position.x), sizeof(float));
-            fileHandle.write(reinterpret_cast<const char*>(&model.meshes[i].vertices[v].Position.y), sizeof(float));
-            fileHandle.write(reinterpret_cast<const char*>(&model.meshes[i].vertices[v].Position.z), sizeof(float));
-            /*texture coordinates*/
-            fileHandle.write(reinterpret_cast<const char*>(&model.meshes[i].vertices[v].Texture.x), sizeof(float));
-            fileHandle.write(reinterpret_cast<const char*>(&model.meshes[i].vertices[v].Texture.y), sizeof(float));
-            /*normals*/
-            fileHandle.write(reinterpret_cast<const char*>(&model.meshes[i].vertices[v].Normal.x), sizeof(float));
-            fileHandle.write(reinterpret_cast<const char*>(&model.meshes[i].vertices[v].Normal.y), sizeof(float));
-            fileHandle.write(reinterpret_cast<const char*>(&model.meshes[i].vertices[v].Normal.z), sizeof(float));
-            /*tangentU*/
-            fileHandle.write(reinterpret_cast<const char*>(&model.meshes[i].vertices[v].TangentU.x), sizeof(float));
-            fileHandle.write(reinterpret_cast<const char*>(&model.meshes[i].vertices[v].TangentU.y), sizeof(float));
-            fileHandle.write(reinterpret_cast<const char*>(&model.meshes[i].vertices[v].TangentU.z), sizeof(float));
-
-            /*bone weights only for rigged*/
+        /*positions are relative to the mesh bounds when quantized*/
+        QuantizationRecord quantization = computeQuantization(model.meshes[i].vertices);
+
+        /*vertices, packed into one contiguous stream, bone weights only for rigged*/
+        if (initData.quantize)
+        {
+            fileHandle.write(reinterpret_cast<const char*>(&quantization), sizeof(quantization));
+
             if (model.isRigged)
             {
-                /*fill bone data*/
-                while (model.meshes[i].vertices[v].BlendIndices.size() < 4)
-                {
-                    model.meshes[i].vertices[v].BlendIndices.push_back(0);
-                }
+                quantizedSkinnedRecords.resize(verticesSize);
 
-                while (model.meshes[i].vertices[v].BlendWeights.size() < 4)
+                for (int v = 0; v < verticesSize; v++)
                 {
-                    model.meshes[i].vertices[v].BlendWeights.push_back(0.0f);
+                    packVertex(model.meshes[i].vertices[v], quantization, quantizedSkinnedRecords[v]);
                 }
 
-                /*bone indices*/
-                for (int k = 0; k < 4; k++)
+                fileHandle.write(reinterpret_cast<const char*>(quantizedSkinnedRecords.data()), sizeof(QuantizedSkinnedVertexRecord) * verticesSize);
+            }
+            else
+            {
+                quantizedStaticRecords.resize(verticesSize);
+
+                for (int v = 0; v < verticesSize; v++)
                 {
-                    fileHandle.write(reinterpret_cast<const char*>(&model.meshes[i].vertices[v].BlendIndices[k]), sizeof(UINT));
-                    fileHandle.write(reinterpret_cast<const char*>(&model.meshes[i].vertices[v].BlendWeights[k]), sizeof(float));
+                    packVertex(model.meshes[i].vertices[v], quantization, quantizedStaticRecords[v]);
                 }
+
+                fileHandle.write(reinterpret_cast<const char*>(quantizedStaticRecords.data()), sizeof(QuantizedStaticVertexRecord) * verticesSize);
             }
         }
+        else if (model.isRigged)
+        {
+            skinnedRecords.resize(verticesSize);
+
+            for (int v = 0; v < verticesSize; v++)
+            {
+                packVertex(model.meshes[i].vertices[v], skinnedRecords[v]);
+            }
+
+            fileHandle.write(reinterpret_cast<const char*>(skinnedRecords.data()), sizeof(SkinnedVertexRecord) * verticesSize);
+        }
+        else
+        {
+            staticRecords.resize(verticesSize);
+
+            for (int v = 0; v < verticesSize; v++)
+            {
+                packVertex(model.meshes[i].vertices[v], staticRecords[v]);
+            }
+
+            fileHandle.write(reinterpret_cast<const char*>(staticRecords.data()), sizeof(StaticVertexRecord) * verticesSize);
+        }
+
+        /*index width, 16 bit whenever every vertex is addressable, 0xffff stays free for primitive restart*/
+        bool shortIndices = initData.shortIndices && verticesSize < 65536;
+
+        if (initData.shortIndices)
+        {
+            BYTE indexWidth = shortIndices ? sizeof(uint16_t) : sizeof(UINT);
+            fileHandle.write(reinterpret_cast<const char*>(&indexWidth), sizeof(BYTE));
+        }
 
         /*num indices*/
         int indicesSize = (int)model.meshes[i].indices.size();
         fileHandle.write(reinterpret_cast<const char*>(&indicesSize), sizeof(int));
 
         /*indices*/
-        for (int j = 0; j < indicesSize; j++)
+        if (shortIndices)
+        {
+            shortIndexRecords.assign(model.meshes[i].indices.begin(), model.meshes[i].indices.end());
+            fileHandle.write(reinterpret_cast<const char*>(shortIndexRecords.data()), sizeof(uint16_t) * indicesSize);
+        }
+        else
         {
-            fileHandle.write(reinterpret_cast<const char*>(&model.meshes[i].indices[j]), sizeof(UINT));
+            fileHandle.write(reinterpret_cast<const char*>(model.meshes[i].indices.data()), sizeof(UINT) * indicesSize);
+        }
+
+        /*meshlets with their culling bounds*/
+        if (initData.meshlets)
+        {
+            const MeshletData& data = meshlets[i];
+
+            /*quantized positions may move by half a step, the spheres have to contain them*/
+            float padding = initData.quantize ? 0.5f * aiVector3D(quantization.PositionScale[0], quantization.PositionScale[1], quantization.PositionScale[2]).Length() : 0.0f;
+
+            meshletRecords.resize(data.meshlets.size());
+
+            for (size_t k = 0; k < data.meshlets.size(); k++)
+            {
+                packMeshlet(data.meshlets[k], padding, meshletRecords[k]);
+            }
+
+            UINT meshletCount = (UINT)meshletRecords.size();
+            UINT meshletVertexCount = (UINT)data.vertices.size();
+            UINT meshletTriangleCount = (UINT)(data.triangles.size() / 3);
+
+            fileHandle.write(reinterpret_cast<const char*>(&meshletCount), sizeof(UINT));
+            fileHandle.write(reinterpret_cast<const char*>(meshletRecords.data()), sizeof(MeshletRecord) * meshletCount);
+            fileHandle.write(reinterpret_cast<const char*>(&meshletVertexCount), sizeof(UINT));
+            fileHandle.write(reinterpret_cast<const char*>(data.vertices.data()), sizeof(UINT) * meshletVertexCount);
+            fileHandle.write(reinterpret_cast<const char*>(&meshletTriangleCount), sizeof(UINT));
+            fileHandle.write(reinterpret_cast<const char*>(data.triangles.data()), 3 * (size_t)meshletTriangleCount);
         }
+
+        meshIndex[i].Size = (uint64_t)fileHandle.tellp() - meshIndex[i].Offset;
+    }
+
+    endSection();
+
+    /*mesh index, lets readers load single meshes*/
+    if (sectioned)
+    {
+        beginSection(SECTION_MESH_INDEX);
+        writeCount(meshSize);
+        fileHandle.write(reinterpret_cast<const char*>(meshIndex.data()), sizeof(MeshIndexRecord) * meshSize);
+        endSection();
+    }
+
+    auto bytesWritten = (long long)fileHandle.tellp();
+
+    if (sectioned)
+    {
+        fileHandle.seekp(sectionTableOffset);
+        fileHandle.write(reinterpret_cast<const char*>(sections.data()), sizeof(SectionRecord) * sections.size());
     }
 
     fileHandle.close();
 
-    std::cout << "\nFinished writing " << model.fileName << "." << std::endl;
+    stats.outputBytes += bytesWritten;
+    stats.outputFiles.push_back(model.fileName);
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    auto writeTime = std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count();
+
+    out() << "\nFinished writing " << model.fileName << " (" << bytesWritten << " bytes in " << writeTime / 1000.0 << "ms, "
+        << (writeTime > 0 ? bytesWritten / (double)writeTime : 0.0) << " MB/s)." << std::endl;
 
     return true;
 }
 
+bool ModelConverter::isSupportedFile(const std::string& fileName) const
+{
+    std::string::size_type idx = fileName.rfind('.');
+
+    if (idx == std::string::npos)
+    {
+        return false;
+    }
+
+    std::string ext = fileName.substr(idx + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return (char)tolower(c); });
+
+    if (ext == "b3d" || ext == "s3d" || ext == "clp")
+    {
+        return false;
+    }
+
+    Assimp::Importer importer;
+    return importer.IsExtensionSupported("." + ext);
+}
+
 void ModelConverter::printFile(const std::string& fileName, bool verbose)
 {
     std::cout.precision(4);
@@ -702,18 +1277,18 @@ void ModelConverter::printFile(const std::string& fileName, bool verbose)
     {
         std::string ext = fileName.substr(idx + 1);
 
-        if (ext == "b3d")
-        {
-            printB3D(fileName, verbose);
-        }
-        else if (ext == "s3d")
+        if (ext == "b3d" || ext == "s3d")
         {
-            printS3D(fileName, verbose);
+            printModel(fileName, verbose);
         }
         else if (ext == "clp")
         {
             printCLP(fileName, verbose);
         }
+        else if (ext == "pak")
+        {
+            printPack(fileName, verbose);
+        }
         else
         {
             std::cerr << "Invalid file!" << std::endl;
@@ -726,518 +1301,368 @@ void ModelConverter::printFile(const std::string& fileName, bool verbose)
     return;
 }
 
-void ModelConverter::printB3D(const std::string& fileName, bool verbose)
+void ModelConverter::printModel(const std::string& fileName, bool verbose)
 {
-    std::cout << "Printing B3D file " << fileName << "..\n" << std::endl;
-    std::cout << "\n---------------------------------------------------\n\n";
-
-    /*open file*/
-    std::streampos fileSize;
-    std::ifstream file(fileName, std::ios::binary);
-
-    /*get file size*/
-    file.seekg(0, std::ios::end);
-    fileSize = file.tellg();
-    file.seekg(0, std::ios::beg);
+    ModelReader reader;
 
-    if (fileSize == 0 || !file.good())
+    if (!reader.open(fileName))
     {
-        std::cerr << "Can not open file!\n";
+        std::cerr << reader.getError() << "\n";
         return;
     }
 
-    /*check header*/
-    bool header = true;
-    char headerBuffer[4] = { 'b','3','d','f' };
+    std::cout << "Printing " << (reader.isSkinned() ? "S3D" : "B3D") << " file " << fileName << "..\n" << std::endl;
 
-    for (int i = 0; i < 4; i++)
+    if (reader.isExtended())
     {
-        char temp;
-        file.read(&temp, sizeof(temp));
+        std::cout << "Format version:\t" << reader.getVersion() << "\n";
+        std::cout << "Encoding:\t" << ((reader.getFlags() & FORMAT_QUANTIZED) ? "Quantized" : "Full precision") << "\n";
 
-        if (temp != headerBuffer[i])
+        for (const auto& s : reader.getSections())
         {
-            header = false;
-            break;
+            std::cout << "Section " << s.Type << ":\t" << s.Size << " bytes at offset " << s.Offset << "\n";
         }
-    }
 
-    if (header == false)
-    {
-        /*header incorrect*/
-        std::cerr << "File contains incorrect header!\n";
-        return;
+        std::cout << std::endl;
     }
+    std::cout << "\n---------------------------------------------------\n\n";
 
-    char numMeshes;
-    file.read(&numMeshes, sizeof(numMeshes));
-
-    std::cout << std::showpoint << "Number of meshes: " << (int)numMeshes << "\n\n";
+    std::cout << std::showpoint;
 
-    for (char i = 0; i < numMeshes; i++)
+    /*bone data only in s3d*/
+    if (reader.isSkinned())
     {
-        std::cout << "\n===================================================\n\n";
-        std::cout << "Mesh " << (int)i << ":\n\n";
-
-        short slen = 0;
-        file.read((char*)(&slen), sizeof(short));
-
-        char* matStr = new char[(INT_PTR)slen + 1];
-        file.read(matStr, slen);
-        matStr[slen] = '\0';
-
-        std::cout << "Material:\t" << matStr << "\n";
-
-        int vertCount = 0;
-        file.read((char*)(&vertCount), sizeof(vertCount));
+        const auto& bones = reader.getBones();
 
-        std::cout << "VertCount:\t" << vertCount << "\n";
+        std::cout << "NumBones: " << bones.size() << std::endl;
 
         std::cout << "\n---------------------------------------------------\n\n";
 
-        Vertex vertex;
+        std::vector<std::string> boneNames(bones.size());
 
-        for (int j = 0; j < vertCount; j++)
+        for (const auto& b : bones)
         {
-            file.read((char*)(&vertex.Position.x), sizeof(float));
-            file.read((char*)(&vertex.Position.y), sizeof(float));
-            file.read((char*)(&vertex.Position.z), sizeof(float));
-
-            file.read((char*)(&vertex.Texture.x), sizeof(float));
-            file.read((char*)(&vertex.Texture.y), sizeof(float));
-
-            file.read((char*)(&vertex.Normal.x), sizeof(float));
-            file.read((char*)(&vertex.Normal.y), sizeof(float));
-            file.read((char*)(&vertex.Normal.z), sizeof(float));
+            if (b.id < (int)boneNames.size())
+            {
+                boneNames[b.id] = std::string(b.name);
+            }
 
-            file.read((char*)(&vertex.TangentU.x), sizeof(float));
-            file.read((char*)(&vertex.TangentU.y), sizeof(float));
-            file.read((char*)(&vertex.TangentU.z), sizeof(float));
+            std::cout << "Bone ID:\t" << b.id << "\n";
+            std::cout << "Bone Name:\t" << b.name << "\n";
 
             if (verbose)
             {
-                std::cout << "Pos: " << vertex.Position.x << " | " << vertex.Position.y << " | " << vertex.Position.z << "\n";
-                std::cout << "Tex: " << vertex.Texture.x << " | " << vertex.Texture.y << "\n";
-                std::cout << "Nor: " << vertex.Normal.x << " | " << vertex.Normal.y << " | " << vertex.Normal.z << "\n";
-                std::cout << "Tan: " << vertex.TangentU.x << " | " << vertex.TangentU.y << " | " << vertex.TangentU.z << "\n";
-                std::cout << "\n";
+                printAIMatrix(toAIMatrix(*b.offsetMatrix));
             }
-        }
-
-        if (verbose)
-            std::cout << "\n---------------------------------------------------\n\n";
-
-        int vInd = 0;
-        file.read((char*)(&vInd), sizeof(vInd));
 
-        std::cout << "IndCount:\t" << vInd << "\n";
+            std::cout << "\n";
+        }
 
         std::cout << "\n---------------------------------------------------\n\n";
 
-        int temp = 0;
-
-        for (int j = 0; j < vInd; j++)
+        for (const auto& h : reader.getBoneHierarchy())
         {
-            file.read((char*)(&temp), sizeof(int));
+            if (h.Bone < 0 || h.Bone >= (int)boneNames.size()) continue;
 
-            if (verbose)
-            {
-                if ((j + 1) % 3 != 0)
-                {
-                    std::cout << temp << ", ";
-                }
-                else
-                {
-                    std::cout << temp << "\n";
-                }
-            }
+            std::cout << boneNames[h.Bone] << " (" << h.Bone << ") is child of bone " << (h.Parent >= 0 && h.Parent < (int)boneNames.size() ? boneNames[h.Parent] : "-1") << " (" << h.Parent << ")" << std::endl;
         }
-        std::cout << std::endl;
-    }
-}
-
-void ModelConverter::printS3D(const std::string& fileName, bool verbose)
-{
-    std::cout << "Printing S3D file " << fileName << "..\n" << std::endl;
-    std::cout << "\n---------------------------------------------------\n\n";
-
-    /*open file*/
-    std::streampos fileSize;
-    std::ifstream file(fileName, std::ios::binary);
-
-    /*get file size*/
-    file.seekg(0, std::ios::end);
-    fileSize = file.tellg();
-    file.seekg(0, std::ios::beg);
-
-    if (fileSize == 0 || !file.good())
-    {
-        std::cerr << "Can not open file!\n";
-        return;
-    }
 
-    /*check header*/
-    bool header = true;
-    char headerBuffer[4] = { 's','3','d','f' };
-
-    for (int i = 0; i < 4; i++)
-    {
-        char temp;
-        file.read(&temp, sizeof(temp));
+        std::cout << "\n\n---------------------------------------------------\n\n";
 
-        if (temp != headerBuffer[i])
+        /*node tree*/
+        for (const auto& n : reader.getNodes())
         {
-            header = false;
-            break;
+            aiMatrix4x4 transform = toAIMatrix(*n.transform);
+
+            std::cout << std::string((long long)n.depth * 3, ' ') << char(0xC0) << std::string(2, '-') << ">" << n.name;
+            if (transform.IsIdentity())
+            {
+                std::cout << " (Identity Transform)\n";
+            }
+            else
+            {
+                std::cout << "\n";
+                printAIMatrix(transform);
+            }
         }
-    }
 
-    if (header == false)
-    {
-        /*header incorrect*/
-        std::cerr << "File contains incorrect header!\n";
-        return;
+        std::cout << "\n---------------------------------------------------\n\n";
     }
 
-    /*num bones*/
-    char vNumBones = 0;
-    file.read((char*)(&vNumBones), sizeof(char));
-
-    std::cout << std::showpoint << "NumBones: " << (int)vNumBones << std::endl;
-
-    std::cout << "\n---------------------------------------------------\n\n";
-
-    int temp;
-    aiMatrix4x4 mOffset;
+    /*meshes*/
+    const auto& meshes = reader.getMeshes();
 
-    std::vector<std::string> boneNames(vNumBones);
+    std::cout << "Number of meshes: " << meshes.size() << "\n\n";
 
-    for (char i = 0; i < vNumBones; i++)
+    for (size_t i = 0; i < meshes.size(); i++)
     {
-        /*id*/
-        char x;
-        file.read((char*)&x, sizeof(char));
-        temp = (int)x;
+        const MeshView& mesh = meshes[i];
 
-        /*name length*/
-        short slen = 0;
-        file.read((char*)(&slen), sizeof(short));
+        std::cout << "\n===================================================\n\n";
+        std::cout << "Mesh " << i << ":\n\n";
 
-        /*name*/
-        char* bname = new char[(INT_PTR)slen + 1];
-        file.read(bname, slen);
-        bname[slen] = '\0';
+        std::cout << "Material:\t" << mesh.materialName << "\n";
+        std::cout << "VertCount:\t" << mesh.vertexCount() << "\n";
 
-        boneNames[temp] = std::string(bname);
+        if (reader.getFlags() & FORMAT_BONE_PALETTES)
+        {
+            std::cout << "Palette:\t";
 
-        std::cout << "Bone ID:\t" << (int)temp << "\n";
-        std::wcout << "Bone Name:\t" << bname << "\n";
+            for (size_t j = 0; j < mesh.bonePalette.size; j++)
+            {
+                std::cout << (j > 0 ? ", " : "") << mesh.bonePalette[j];
+            }
 
-        /*matrix*/
-        ai_real mOff[16];
-        file.read((char*)&mOff[0], sizeof(float) * 16);
+            std::cout << "\n";
+        }
 
-        mOffset = aiMatrix4x4(mOff[0], mOff[1], mOff[2], mOff[3],
-                              mOff[4], mOff[5], mOff[6], mOff[7],
-                              mOff[8], mOff[9], mOff[10], mOff[11],
-                              mOff[12], mOff[13], mOff[14], mOff[15]
-        );
+        std::cout << "\n---------------------------------------------------\n\n";
 
         if (verbose)
         {
-            printAIMatrix(mOffset);
-        }
-
-        std::cout << "\n";
-    }
-
-    std::vector<int> boneHierarchyCheck(vNumBones);
-
-    for (char i = 0; i < vNumBones; i++)
-    {
-        int index;
-
-        file.read((char*)(&index), sizeof(int));
-        file.read((char*)(&boneHierarchyCheck[index]), sizeof(int));
-    }
+            for (size_t j = 0; j < mesh.vertexCount(); j++)
+            {
+                SkinnedVertexRecord skinned = mesh.skinnedVertex(j);
+                const StaticVertexRecord& vertex = skinned.Base;
 
-    std::cout << "\n---------------------------------------------------\n\n";
+                if (reader.isSkinned())
+                {
+                    std::cout << "Vertex Index: " << j << "\n";
+                }
 
-    for (int i = 0; i < boneHierarchyCheck.size(); i++)
-    {
-        std::cout << boneNames[i] << " (" << i << ") is child of bone " << (boneHierarchyCheck[i] >= 0 ? boneNames[boneHierarchyCheck[i]] : "-1") << " (" << boneHierarchyCheck[i] << ")" << std::endl;
-    }
+                std::cout << "Pos: " << vertex.Position[0] << " | " << vertex.Position[1] << " | " << vertex.Position[2] << "\n";
+                std::cout << "Tex: " << vertex.Texture[0] << " | " << vertex.Texture[1] << "\n";
+                std::cout << "Nor: " << vertex.Normal[0] << " | " << vertex.Normal[1] << " | " << vertex.Normal[2] << "\n";
+                std::cout << "Tan: " << vertex.TangentU[0] << " | " << vertex.TangentU[1] << " | " << vertex.TangentU[2] << "\n";
 
-    std::cout << "\n\n---------------------------------------------------\n\n";
+                if (reader.isSkinned())
+                {
+                    std::cout << "BlInd: " << skinned.Influences[0].Index;
+                    for (int k = 1; k < MAX_BONE_INFLUENCES; k++)
+                    {
+                        std::cout << " | " << skinned.Influences[k].Index;
+                    }
+                    std::cout << "\nBlWgt: " << skinned.Influences[0].Weight;
+                    for (int k = 1; k < MAX_BONE_INFLUENCES; k++)
+                    {
+                        std::cout << " | " << skinned.Influences[k].Weight;
+                    }
+                    std::cout << "\n";
+                }
 
-    /*node tree*/
-    Node root;
+                std::cout << "\n";
+            }
 
-    std::function<void(Node*, Node*)> loadTree = [&](Node* node, Node* parent)
-    {
-        /*read data*/
-        short slen = 0;
-        file.read((char*)(&slen), sizeof(short));
+            std::cout << "\n---------------------------------------------------\n\n";
+        }
 
-        char* nameStr = new char[(INT_PTR)slen + 1];
-        file.read(nameStr, slen);
-        nameStr[slen] = '\0';
+        std::cout << "IndCount:\t" << mesh.indexCount() << "\n";
+        std::cout << "IndWidth:\t" << mesh.indexWidth() * 8 << " bit\n";
 
-        ai_real mTemp[16];
-        file.read((char*)&mTemp[0], sizeof(float) * 16);
+        if (!mesh.meshlets.empty())
+        {
+            std::cout << "Meshlets:\t" << mesh.meshlets.size << " (" << mesh.meshletVertices.size / (float)mesh.meshlets.size << " vertices, "
+                << mesh.meshletTriangles.size / 3.0f / mesh.meshlets.size << " triangles on average)\n";
 
-        int numChildren = 0;
-        file.read((char*)(&numChildren), sizeof(int));
+            if (verbose)
+            {
+                for (size_t j = 0; j < mesh.meshlets.size; j++)
+                {
+                    const MeshletRecord& meshlet = mesh.meshlets[j];
 
-        /*fill node*/
-        node->name = nameStr;
-        node->transform = aiMatrix4x4(mTemp[0], mTemp[1], mTemp[2], mTemp[3],
-                                      mTemp[4], mTemp[5], mTemp[6], mTemp[7],
-                                      mTemp[8], mTemp[9], mTemp[10], mTemp[11],
-                                      mTemp[12], mTemp[13], mTemp[14], mTemp[15]
-        );
+                    std::cout << "Meshlet " << j << ": " << (int)meshlet.VertexCount << " vertices, " << (int)meshlet.TriangleCount << " triangles, sphere "
+                        << meshlet.Center[0] << " | " << meshlet.Center[1] << " | " << meshlet.Center[2] << " r " << meshlet.Radius << ", cone "
+                        << meshlet.ConeAxis[0] << " | " << meshlet.ConeAxis[1] << " | " << meshlet.ConeAxis[2] << " cutoff " << meshlet.ConeCutoff << "\n";
+                }
+            }
+        }
 
-        node->parent = parent;
+        std::cout << "\n---------------------------------------------------\n\n";
 
-        for (int i = 0; i < numChildren; i++)
+        if (verbose)
         {
-            node->children.push_back(Node());
-            loadTree(&node->children.back(), node);
+            for (size_t j = 0; j < mesh.indexCount(); j++)
+            {
+                std::cout << mesh.index(j) << ((j + 1) % 3 != 0 ? ", " : "\n");
+            }
         }
-    };
-
-    loadTree(&root, nullptr);
+        std::cout << std::endl;
+    }
 
-    printNodes(&root);
+    if (!reader.validate())
+    {
+        std::cerr << "Validation failed: " << reader.getError() << std::endl;
+    }
+}
 
+void ModelConverter::printCLP(const std::string& fileName, bool verbose)
+{
+    std::cout << "Printing CLP file " << fileName << "..\n" << std::endl;
     std::cout << "\n---------------------------------------------------\n\n";
 
-    /*meshes*/
-    char numMeshes;
-    file.read(&numMeshes, sizeof(numMeshes));
-
-    std::cout << "Number of meshes: " << (int)numMeshes << "\n\n";
+    ClipReader reader;
 
-    for (char i = 0; i < numMeshes; i++)
+    if (!reader.open(fileName))
     {
-        std::cout << "\n===================================================\n\n";
-        std::cout << "Mesh " << (int)i << ":\n\n";
-
-        short slen = 0;
-        file.read((char*)(&slen), sizeof(short));
-
-        char* matStr = new char[(INT_PTR)slen + 1];
-        file.read(matStr, slen);
-        matStr[slen] = '\0';
-
-        std::cout << "Material:\t" << matStr << "\n";
+        std::cerr << reader.getError() << "\n";
+        return;
+    }
 
-        int vertCount = 0;
-        file.read((char*)(&vertCount), sizeof(vertCount));
+    const auto& tracks = reader.getTracks();
+    bool channels = (reader.getFlags() & CLIP_CHANNELS) != 0;
 
-        std::cout << "VertCount:\t" << vertCount << "\n";
+    if (reader.isExtended())
+    {
+        std::cout << "Format version:\t" << reader.getVersion() << "\n";
+        std::cout << "Tracks:\t\t" << (channels ? "Channels" : "Key frames") << "\n";
+        std::cout << "Encoding:\t" << ((reader.getFlags() & CLIP_QUANTIZED) ? "Quantized" : "Full precision") << "\n\n";
+    }
 
-        std::cout << "\n---------------------------------------------------\n\n";
+    std::cout << std::showpoint << "Name:\t" << reader.getName() << "\n";
+    std::cout << "Bones:\t" << tracks.size() << "\n";
 
-        Vertex vertex;
+    for (size_t i = 0; i < tracks.size(); i++)
+    {
+        std::cout << "\n===================================================\n\n";
 
-        for (int j = 0; j < vertCount; j++)
+        if (tracks[i].isEmpty)
         {
-            file.read((char*)(&vertex.Position.x), sizeof(float));
-            file.read((char*)(&vertex.Position.y), sizeof(float));
-            file.read((char*)(&vertex.Position.z), sizeof(float));
+            std::cout << "Bone " << i << " has no key frames.\n\n";
+            continue;
+        }
 
-            file.read((char*)(&vertex.Texture.x), sizeof(float));
-            file.read((char*)(&vertex.Texture.y), sizeof(float));
+        if (channels)
+        {
+            const TrackView& t = tracks[i];
 
-            file.read((char*)(&vertex.Normal.x), sizeof(float));
-            file.read((char*)(&vertex.Normal.y), sizeof(float));
-            file.read((char*)(&vertex.Normal.z), sizeof(float));
+            std::cout << "Bone " << i << " has " << t.translation.size << " translation, " << t.rotation.size << " rotation and "
+                << t.scale.size << " scale keys.\n\n";
 
-            file.read((char*)(&vertex.TangentU.x), sizeof(float));
-            file.read((char*)(&vertex.TangentU.y), sizeof(float));
-            file.read((char*)(&vertex.TangentU.z), sizeof(float));
+            if (!verbose) continue;
 
-            vertex.BlendIndices.resize(4);
-            vertex.BlendWeights.resize(4);
+            for (size_t j = 0; j < t.translation.size; j++)
+            {
+                VectorRecord v = t.translation.value(j);
+                std::cout << "Transl #" << j << "\t" << t.translation.time(j) << ":\t" << v.Value[0] << " | " << v.Value[1] << " | " << v.Value[2] << "\n";
+            }
 
-            for (int k = 0; k < 4; k++)
+            for (size_t j = 0; j < t.rotation.size; j++)
             {
-                file.read((char*)(&vertex.BlendIndices[k]), sizeof(UINT));
-                file.read((char*)(&vertex.BlendWeights[k]), sizeof(float));
+                QuaternionRecord v = t.rotation.value(j);
+                std::cout << "RotQu #" << j << "\t" << t.rotation.time(j) << ":\t" << v.Value[0] << " | " << v.Value[1] << " | " << v.Value[2] << " | " << v.Value[3] << "\n";
             }
 
-            if (verbose)
+            for (size_t j = 0; j < t.scale.size; j++)
             {
-                std::cout << "Vertex Index: " << j << "\n";
-                std::cout << "Pos: " << vertex.Position.x << " | " << vertex.Position.y << " | " << vertex.Position.z << "\n";
-                std::cout << "Tex: " << vertex.Texture.x << " | " << vertex.Texture.y << "\n";
-                std::cout << "Nor: " << vertex.Normal.x << " | " << vertex.Normal.y << " | " << vertex.Normal.z << "\n";
-                std::cout << "Tan: " << vertex.TangentU.x << " | " << vertex.TangentU.y << " | " << vertex.TangentU.z << "\n";
-                std::cout << "BlInd: " << vertex.BlendIndices[0] << " | " << vertex.BlendIndices[1] << " | " << vertex.BlendIndices[2] << " | " << vertex.BlendIndices[3] << "\n";
-                std::cout << "BlWgt: " << vertex.BlendWeights[0] << " | " << vertex.BlendWeights[1] << " | " << vertex.BlendWeights[2] << " | " << vertex.BlendWeights[3] << "\n";
-                std::cout << "\n";
+                VectorRecord v = t.scale.value(j);
+                std::cout << "Scale #" << j << "\t" << t.scale.time(j) << ":\t" << v.Value[0] << " | " << v.Value[1] << " | " << v.Value[2] << "\n";
             }
-        }
 
-        if (verbose)
             std::cout << "\n---------------------------------------------------\n\n";
+            continue;
+        }
 
-        int vInd = 0;
-        file.read((char*)(&vInd), sizeof(vInd));
-
-        std::cout << "IndCount:\t" << vInd << "\n";
-
-        std::cout << "\n---------------------------------------------------\n\n";
+        std::cout << "Bone " << i << " has " << tracks[i].keyFrames.size << " key frames.\n\n";
 
-        int temp = 0;
+        if (!verbose) continue;
 
-        for (int j = 0; j < vInd; j++)
+        for (size_t j = 0; j < tracks[i].keyFrames.size; j++)
         {
-            file.read((char*)(&temp), sizeof(int));
+            const KeyFrameRecord& kf = tracks[i].keyFrames[j];
 
-            if (verbose)
-            {
-                if ((j + 1) % 3 != 0)
-                {
-                    std::cout << temp << ", ";
-                }
-                else
-                {
-                    std::cout << temp << "\n";
-                }
-            }
+            std::cout << "Bone " << i << " Keyframe #" << j << "\n";
+            std::cout << "TimePos:\t" << kf.TimeStamp << "\n";
+            std::cout << "Transl:\t" << kf.Translation[0] << " | " << kf.Translation[1] << " | " << kf.Translation[2] << "\n";
+            std::cout << "Scale:\t" << kf.Scale[0] << " | " << kf.Scale[1] << " | " << kf.Scale[2] << "\n";
+            std::cout << "RotQu:\t" << kf.RotationQuat[0] << " | " << kf.RotationQuat[1] << " | " << kf.RotationQuat[2] << " | " << kf.RotationQuat[3] << "\n";
+            std::cout << "\n---------------------------------------------------\n\n";
         }
-        std::cout << std::endl;
     }
 }
 
-void ModelConverter::printCLP(const std::string& fileName, bool verbose)
+void ModelConverter::printPack(const std::string& fileName, bool verbose)
 {
-    std::cout << "Printing CLP file " << fileName << "..\n" << std::endl;
-    std::cout << "\n---------------------------------------------------\n\n";
+    std::cout << "Printing pack " << fileName << "..\n" << std::endl;
 
-    /*open file*/
-    std::streampos fileSize;
-    std::ifstream file(fileName, std::ios::binary);
+    PackReader reader;
 
-    /*get file size*/
-    file.seekg(0, std::ios::end);
-    fileSize = file.tellg();
-    file.seekg(0, std::ios::beg);
-
-    if (fileSize == 0 || !file.good())
+    if (!reader.open(fileName))
     {
-        std::cerr << "Can not open file!\n";
+        std::cerr << reader.getError() << "\n";
         return;
     }
 
-    /*check header*/
-    bool header = true;
-    char headerBuffer[4] = { 'c','l','p','f' };
-
-    for (int i = 0; i < 4; i++)
-    {
-        char temp;
-        file.read(&temp, sizeof(temp));
+    std::cout << "Entries:\t" << reader.getEntries().size << "\n";
+    std::cout << "Alignment:\t" << reader.getAlignment() << " bytes\n";
+    std::cout << "\n---------------------------------------------------\n\n";
 
-        if (temp != headerBuffer[i])
-        {
-            header = false;
-            break;
-        }
-    }
+    std::vector<char> buffer;
 
-    if (header == false)
+    for (const auto& e : reader.getEntries())
     {
-        /*header incorrect*/
-        std::cerr << "File contains incorrect header!\n";
-        return;
-    }
-
-    int slen = 0;
-    file.read((char*)(&slen), sizeof(int));
+        std::string_view name = reader.getName(e);
 
-    char* animName = new char[(INT_PTR)slen + 1];
-    file.read(animName, slen);
-    animName[slen] = '\0';
+        std::cout << name << "\t" << e.Size << " bytes";
 
-    std::cout << std::showpoint << "Name:\t" << animName << "\n";
-
-    UINT vNumBones = 0;
-    file.read((char*)(&vNumBones), sizeof(int));
+        if (e.Compression == PACK_LZ4)
+        {
+            std::cout << ", LZ4 " << e.StoredSize << " bytes";
+        }
 
-    std::cout << "Bones:\t" << vNumBones << "\n";
+        if (verbose)
+        {
+            std::cout << " at offset " << e.Offset << ", hash " << std::hex << e.NameHash << std::dec;
+        }
 
-    for (UINT i = 0; i < vNumBones; i++)
-    {
-        std::cout << "\n===================================================\n\n";
+        std::cout << "\n";
 
-        UINT vKeyFrames = 0;
-        file.read((char*)(&vKeyFrames), sizeof(int));
+        /*entries are parsed in place, compressed ones after decompression*/
+        std::string_view data;
 
-        if (vKeyFrames == -1)
+        if (!reader.read(e, buffer, data))
         {
-            std::cout << "Bone " << (int)i << " has no key frames.\n\n";
+            std::cerr << reader.getError() << "\n";
             continue;
         }
 
-        std::cout << "Bone " << (int)i << " has " << vKeyFrames << " key frames.\n\n";
+        std::string ext = name.size() >= 4 ? std::string(name.substr(name.size() - 4)) : "";
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return (char)tolower(c); });
 
-        for (UINT j = 0; j < vKeyFrames; j++)
+        if (ext == ".b3d" || ext == ".s3d")
         {
-            if (verbose)
-                std::cout << "Bone " << i << " Keyframe #" << j << "\n";
-
-            float temp, temp2, temp3, temp4;
-            file.read((char*)(&temp), sizeof(float));
-            if (verbose)
-                std::cout << "TimePos:\t" << temp << "\n";
+            ModelReader model;
 
-            file.read((char*)(&temp), sizeof(float));
-            file.read((char*)(&temp2), sizeof(float));
-            file.read((char*)(&temp3), sizeof(float));
-            if (verbose)
-                std::cout << "Transl:\t" << temp << " | " << temp2 << " | " << temp3 << "\n";
-
-            file.read((char*)(&temp), sizeof(float));
-            file.read((char*)(&temp2), sizeof(float));
-            file.read((char*)(&temp3), sizeof(float));
-            if (verbose)
-                std::cout << "Scale:\t" << temp << " | " << temp2 << " | " << temp3 << "\n";
+            if (!model.openData(data.data(), data.size()) || !model.validate())
+            {
+                std::cerr << "Validation of " << name << " failed: " << model.getError() << std::endl;
+            }
+        }
+        else if (ext == ".clp")
+        {
+            ClipReader clip;
 
-            file.read((char*)(&temp), sizeof(float));
-            file.read((char*)(&temp2), sizeof(float));
-            file.read((char*)(&temp3), sizeof(float));
-            file.read((char*)(&temp4), sizeof(float));
-            if (verbose)
-                std::cout << "RotQu:\t" << temp << " | " << temp2 << " | " << temp3 << " | " << temp4 << "\n";
-            if (verbose)
-                std::cout << "\n---------------------------------------------------\n\n";
+            if (!clip.openData(data.data(), data.size()))
+            {
+                std::cerr << "Validation of " << name << " failed: " << clip.getError() << std::endl;
+            }
         }
     }
-
-    file.close();
 }
 
-bool ModelConverter::writeAnimations()
+bool ModelConverter::writeAnimations(const InitData& initData)
 {
-    std::cout << "\n===================================================\n\n";
+    /*quantization is only defined for the channel layout*/
+    bool channelClips = initData.channelClips || initData.quantizeClips;
+
+    out() << "\n===================================================\n\n";
 
     for (auto& f : model.animations)
     {
         /*writing to binary file .clp*/
         auto startTime = std::chrono::high_resolution_clock::now();
 
-        std::ios_base::sync_with_stdio(false);
-        std::cin.tie(NULL);
-
-        std::cout << "Write animation as " << f.name << "? (y/other name, name 0 50 100 for key frame selection)\n";
-
-        std::string inputName;
-        std::getline(std::cin, inputName);
-
-        int keyfrSize = (int)f.keyframes[0].size();
+        std::string inputName = ask("Write animation as " + f.name + "? (y/other name, name 0 50 100 for key frame selection)\n", initData.batch, initData.clips, f.name);
+        bool selected = false;
 
         if (!inputName.empty())
         {
@@ -1245,7 +1670,7 @@ bool ModelConverter::writeAnimations()
 
             if (splitInput.size() > 1)
             {
-                keyfrSize = (int)splitInput.size() - 1;
+                selected = true;
 
                 for (int i = 0; i < f.keyframes.size(); i++)
                 {
@@ -1257,21 +1682,103 @@ bool ModelConverter::writeAnimations()
 
                 for (size_t i = 1; i < splitInput.size(); i++)
                 {
-                    int k = std::stoi(splitInput[i]);
+                    char* end = nullptr;
+                    long k = strtol(splitInput[i].c_str(), &end, 10);
 
-                    if (k >= f.keyframes[0].size()) continue;
+                    if (end == splitInput[i].c_str() || k < 0 || k >= (long)f.keyframes[0].size())
+                    {
+                        out() << "Ignoring invalid key frame " << splitInput[i] << ".\n";
+                        continue;
+                    }
 
                     for (int i = 0; i < f.keyframes.size(); i++)
                     {
-                        f.keyframes[i][k].saveToFile = true;
+                        if (k < (long)f.keyframes[i].size())
+                        {
+                            f.keyframes[i][k].saveToFile = true;
+                        }
                     }
                 }
             }
 
-            f.name = splitInput[0];
+            /*y keeps the current name*/
+            if (splitInput[0] != "y")
+            {
+                f.name = splitInput[0];
+            }
+        }
+
+        /*a selection picks sampled key frames, the channels are rebuilt from them*/
+        if (channelClips && selected)
+        {
+            for (size_t i = 0; i < f.keyframes.size(); i++)
+            {
+                f.channels[i] = BoneChannels();
+
+                if (f.keyframes[i].size() == 1 && f.keyframes[i][0].isEmpty) continue;
+
+                for (const auto& kf : f.keyframes[i])
+                {
+                    if (!kf.saveToFile) continue;
+
+                    f.channels[i].translation.push_back({ kf.timeStamp, kf.translation });
+                    f.channels[i].rotation.push_back({ kf.timeStamp, kf.rotationQuat });
+                    f.channels[i].scale.push_back({ kf.timeStamp, kf.scale });
+                }
+            }
+        }
+
+        KeyFrameReductionStats clipStats;
+        unsigned threads = initData.threads > 0 ? initData.threads : defaultThreadCount();
+
+        /*baked clips keep their fixed rate, only constant channels are collapsed*/
+        bool baked = initData.bakeRate > 0.0f;
+
+        /*channels always drop repeated keys, so constant channels keep a single value*/
+        if (channelClips)
+        {
+            KeyFrameTolerance tolerance = initData.reduceKeyFrames ? initData.keyFrameTolerance : KeyFrameTolerance{ 0.0f, 0.0f, 0.0f };
+            std::vector<KeyFrameReductionStats> boneStats(f.channels.size());
+
+            parallelFor(f.channels.size(), threads, [&](size_t i, unsigned)
+            {
+                boneStats[i] = baked ? collapseChannels(f.channels[i], tolerance) : reduceChannels(f.channels[i], tolerance);
+            });
+
+            for (const auto& b : boneStats)
+            {
+                clipStats.add(b);
+            }
+        }
+        /*drop the keys interpolation reproduces, every bone track on its own*/
+        else if (initData.reduceKeyFrames && !baked)
+        {
+            std::vector<KeyFrameReductionStats> boneStats(f.keyframes.size());
+
+            parallelFor(f.keyframes.size(), threads, [&](size_t i, unsigned)
+            {
+                boneStats[i] = reduceKeyFrames(f.keyframes[i], initData.keyFrameTolerance);
+            });
+
+            for (const auto& b : boneStats)
+            {
+                clipStats.add(b);
+            }
+        }
+
+        if (channelClips || (initData.reduceKeyFrames && !baked))
+        {
+            out() << "Reduced key frames from " << clipStats.keysBefore << " to " << clipStats.keysAfter << " ("
+                << (clipStats.keysBefore > 0 ? 100.0 * clipStats.keysAfter / clipStats.keysBefore : 100.0) << "%), max error translation "
+                << clipStats.maxTranslationError << ", rotation " << clipStats.maxRotationError << " deg, scale " << clipStats.maxScaleError << ".\n";
         }
 
-        std::string clipFile = f.name + ".clp";
+        std::string clipFile = outputPath(initData, f.name + ".clp");
+
+        if (!claimOutput(clipFile))
+        {
+            return false;
+        }
 
         auto fileHandle = std::fstream(clipFile.c_str(), std::ios::out | std::ios::binary);
 
@@ -1282,8 +1789,17 @@ bool ModelConverter::writeAnimations()
         }
 
         /*header*/
-        char header[4] = { 0x63, 0x6c, 0x70, 0x66 };
-        fileHandle.write(header, 4);
+        if (channelClips)
+        {
+            ExtendedHeaderRecord extendedHeader = { EXTENDED_FORMAT_VERSION, CLIP_CHANNELS | (initData.quantizeClips ? CLIP_QUANTIZED : 0) };
+            fileHandle.write(CLP_EXTENDED_MAGIC, 4);
+            fileHandle.write(reinterpret_cast<const char*>(&extendedHeader), sizeof(ExtendedHeaderRecord));
+        }
+        else
+        {
+            char header[4] = { 0x63, 0x6c, 0x70, 0x66 };
+            fileHandle.write(header, 4);
+        }
 
         int strSize = (int)f.name.size();
         fileHandle.write(reinterpret_cast<const char*>(&strSize), sizeof(int));
@@ -1292,129 +1808,234 @@ bool ModelConverter::writeAnimations()
         int boneSize = (int)f.keyframes.size();
         fileHandle.write(reinterpret_cast<const char*>(&boneSize), sizeof(int));
 
-        for (int i = 0; i < f.keyframes.size(); i++)
+        if (initData.quantizeClips)
         {
-            if (keyfrSize == 1 && f.keyframes[i][0].isEmpty)
+            float duration = clipDuration(f.channels);
+            std::vector<std::vector<char>> boneRecords(f.channels.size());
+            std::vector<ClipQuantizationStats> boneStats(f.channels.size());
+
+            parallelFor(f.channels.size(), threads, [&](size_t i, unsigned)
             {
-                int t = -1;
-                fileHandle.write(reinterpret_cast<const char*>(&t), sizeof(int));
-                continue;
+                boneStats[i] = encodeChannels(f.channels[i], duration, boneRecords[i]);
+            });
+
+            fileHandle.write(reinterpret_cast<const char*>(&duration), sizeof(float));
+
+            ClipQuantizationStats quantizationStats;
+            size_t channelBytes = 0;
+
+            for (size_t i = 0; i < boneRecords.size(); i++)
+            {
+                fileHandle.write(boneRecords[i].data(), boneRecords[i].size());
+                quantizationStats.add(boneStats[i]);
+                channelBytes += boneRecords[i].size();
             }
 
-            fileHandle.write(reinterpret_cast<const char*>(&keyfrSize), sizeof(int));
+            out() << "Quantized channels to " << channelBytes << " bytes, " << quantizationStats.uniformChannels << " of " << quantizationStats.channels
+                << " animated channels without key times, max error translation " << quantizationStats.maxTranslationError << ", rotation "
+                << quantizationStats.maxRotationError << " deg, scale " << quantizationStats.maxScaleError << ", time " << quantizationStats.maxTimeError << "s.\n";
+        }
+        else if (channelClips)
+        {
+            for (size_t i = 0; i < f.keyframes.size(); i++)
+            {
+                const BoneChannels& c = f.channels[i];
+                ChannelCountsRecord counts = { (UINT)c.translation.size(), (UINT)c.rotation.size(), (UINT)c.scale.size() };
+
+                fileHandle.write(reinterpret_cast<const char*>(&counts), sizeof(ChannelCountsRecord));
+
+                /*times of a channel first, then its values*/
+                for (const auto& key : c.translation)
+                {
+                    fileHandle.write(reinterpret_cast<const char*>(&key.timeStamp), sizeof(float));
+                }
+
+                for (const auto& key : c.translation)
+                {
+                    VectorRecord r = { { key.value.x, key.value.y, key.value.z } };
+                    fileHandle.write(reinterpret_cast<const char*>(&r), sizeof(VectorRecord));
+                }
+
+                for (const auto& key : c.rotation)
+                {
+                    fileHandle.write(reinterpret_cast<const char*>(&key.timeStamp), sizeof(float));
+                }
+
+                for (const auto& key : c.rotation)
+                {
+                    QuaternionRecord r = { { key.value.x, key.value.y, key.value.z, key.value.w } };
+                    fileHandle.write(reinterpret_cast<const char*>(&r), sizeof(QuaternionRecord));
+                }
+
+                for (const auto& key : c.scale)
+                {
+                    fileHandle.write(reinterpret_cast<const char*>(&key.timeStamp), sizeof(float));
+                }
 
-            for (const auto& kf : f.keyframes[i])
+                for (const auto& key : c.scale)
+                {
+                    VectorRecord r = { { key.value.x, key.value.y, key.value.z } };
+                    fileHandle.write(reinterpret_cast<const char*>(&r), sizeof(VectorRecord));
+                }
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < f.keyframes.size(); i++)
             {
-                if (!kf.saveToFile) continue;
+                /*tracks differ in length after selection and reduction*/
+                int keyfrSize = (int)std::count_if(f.keyframes[i].begin(), f.keyframes[i].end(), [](const KeyFrame& kf) { return kf.saveToFile; });
+
+                /*bones without animation or without selected keys are marked with -1*/
+                if (keyfrSize == 0 || (f.keyframes[i].size() == 1 && f.keyframes[i][0].isEmpty))
+                {
+                    int t = -1;
+                    fileHandle.write(reinterpret_cast<const char*>(&t), sizeof(int));
+                    continue;
+                }
+
+                fileHandle.write(reinterpret_cast<const char*>(&keyfrSize), sizeof(int));
+
+                for (const auto& kf : f.keyframes[i])
+                {
+                    if (!kf.saveToFile) continue;
 
-                fileHandle.write(reinterpret_cast<const char*>(&kf.timeStamp), sizeof(float));
+                    fileHandle.write(reinterpret_cast<const char*>(&kf.timeStamp), sizeof(float));
 
-                fileHandle.write(reinterpret_cast<const char*>(&kf.translation.x), sizeof(float));
-                fileHandle.write(reinterpret_cast<const char*>(&kf.translation.y), sizeof(float));
-                fileHandle.write(reinterpret_cast<const char*>(&kf.translation.z), sizeof(float));
+                    fileHandle.write(reinterpret_cast<const char*>(&kf.translation.x), sizeof(float));
+                    fileHandle.write(reinterpret_cast<const char*>(&kf.translation.y), sizeof(float));
+                    fileHandle.write(reinterpret_cast<const char*>(&kf.translation.z), sizeof(float));
 
-                fileHandle.write(reinterpret_cast<const char*>(&kf.scale.x), sizeof(float));
-                fileHandle.write(reinterpret_cast<const char*>(&kf.scale.y), sizeof(float));
-                fileHandle.write(reinterpret_cast<const char*>(&kf.scale.z), sizeof(float));
+                    fileHandle.write(reinterpret_cast<const char*>(&kf.scale.x), sizeof(float));
+                    fileHandle.write(reinterpret_cast<const char*>(&kf.scale.y), sizeof(float));
+                    fileHandle.write(reinterpret_cast<const char*>(&kf.scale.z), sizeof(float));
 
-                fileHandle.write(reinterpret_cast<const char*>(&kf.rotationQuat.x), sizeof(float));
-                fileHandle.write(reinterpret_cast<const char*>(&kf.rotationQuat.y), sizeof(float));
-                fileHandle.write(reinterpret_cast<const char*>(&kf.rotationQuat.z), sizeof(float));
-                fileHandle.write(reinterpret_cast<const char*>(&kf.rotationQuat.w), sizeof(float));
+                    fileHandle.write(reinterpret_cast<const char*>(&kf.rotationQuat.x), sizeof(float));
+                    fileHandle.write(reinterpret_cast<const char*>(&kf.rotationQuat.y), sizeof(float));
+                    fileHandle.write(reinterpret_cast<const char*>(&kf.rotationQuat.z), sizeof(float));
+                    fileHandle.write(reinterpret_cast<const char*>(&kf.rotationQuat.w), sizeof(float));
+                }
             }
         }
 
+        stats.outputBytes += (long long)fileHandle.tellp();
+        stats.outputFiles.push_back(clipFile);
+
         fileHandle.close();
 
         auto endTime = std::chrono::high_resolution_clock::now();
-        std::cout << "\nFinished writing " << clipFile << " in " << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count() << "ms." << std::endl;
-        std::cout << "\n---------------------------------------------------\n\n";
+        out() << "\nFinished writing " << clipFile << " in " << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count() << "ms." << std::endl;
+        out() << "\n---------------------------------------------------\n\n";
     }
 
     return true;
 }
 
-int ModelConverter::findParentBone(const std::vector<Bone>& bones, const aiNode* node)
+int ModelConverter::findParentBone(const std::unordered_map<std::string, int>& boneIndices, const aiNode* node)
 {
-    int result = -1;
-    aiNode* wNode = node->mParent;
-
-    while (wNode)
+    for (aiNode* wNode = node->mParent; wNode; wNode = wNode->mParent)
     {
-        for (int i = 0; i < bones.size(); i++)
+        int index = findIndexInBones(boneIndices, wNode->mName.C_Str());
+
+        if (index >= 0)
         {
-            if (bones[i].name == wNode->mName.C_Str())
-            {
-                result = i;
-                goto skip;
-            }
+            return index;
         }
-
-        wNode = wNode->mParent;
     }
 
-skip:
-    return result;
+    return -1;
+}
+
+int ModelConverter::findIndexInBones(const std::unordered_map<std::string, int>& boneIndices, const std::string& name)
+{
+    auto it = boneIndices.find(name);
+
+    return it != boneIndices.end() ? it->second : -1;
 }
 
-int ModelConverter::findIndexInBones(const std::vector<Bone>& bones, const std::string& name)
+bool ModelConverter::buildBoneHierarchy(const std::vector<Bone>& bones, std::vector<std::pair<int, int>>& hierarchy)
 {
-    for (int i = 0; i < bones.size(); i++)
+    hierarchy.clear();
+    hierarchy.reserve(bones.size());
+
+    /*child adjacency in bone order, every bone without a parent is a root*/
+    std::vector<std::vector<int>> children(bones.size());
+    std::vector<int> roots;
+
+    for (int i = 0; i < (int)bones.size(); i++)
     {
-        if (bones[i].name == name)
+        if (bones[i].parentIndex < 0)
+        {
+            roots.push_back(i);
+        }
+        else
         {
-            return i;
+            children[bones[i].parentIndex].push_back(i);
         }
     }
 
-    return -1;
-}
+    if (roots.size() != 1)
+    {
+        std::cerr << "Can not find root bone or there are more than one root bone!" << std::endl;
 
-bool ModelConverter::existsBoneByName(const std::vector<Bone>& bones, const std::string& name)
-{
-    bool exists = false;
+        for (int r : roots)
+        {
+            std::cerr << "  Root candidate: " << bones[r].name << std::endl;
+        }
 
-    for (auto b : bones)
-    {
-        if (b.name == name)
-            exists = true;
+        return false;
     }
 
-    return exists;
-}
+    /*breadth first from the root so every parent is placed before its children*/
+    std::vector<int> queue;
+    queue.reserve(bones.size());
+    queue.push_back(roots[0]);
 
-bool ModelConverter::isInHierarchy(int index, const std::vector<std::pair<int, int>>& hierarchy)
-{
-    for (const auto& v : hierarchy)
+    for (size_t q = 0; q < queue.size(); q++)
     {
-        if (v.first == index)
+        const Bone& b = bones[queue[q]];
+        hierarchy.push_back(std::pair<int, int>(b.index, b.parentIndex));
+
+        for (int c : children[queue[q]])
         {
-            return true;
+            queue.push_back(c);
         }
     }
-    return false;
-}
-
-bool ModelConverter::isInVector(std::vector<int>& arr, int index)
-{
-    if (index == -1) return true;
 
-    for (const auto& v : arr)
+    /*bones not reached from the root have a parent chain that loops*/
+    if (queue.size() != bones.size())
     {
-        if (v == index) return true;
+        std::vector<bool> reached(bones.size());
+
+        for (int i : queue)
+        {
+            reached[i] = true;
+        }
+
+        std::cerr << "Bone hierarchy error! " << bones.size() - queue.size() << " bone(s) are not connected to root bone " << bones[roots[0]].name << ":" << std::endl;
+
+        for (size_t i = 0; i < bones.size(); i++)
+        {
+            if (!reached[i])
+            {
+                std::cerr << "  " << bones[i].name << " (parent " << bones[i].parentName << ")" << std::endl;
+            }
+        }
+
+        return false;
     }
 
-    return false;
+    return true;
 }
 
 void ModelConverter::printAINodes(aiNode* node, int depth)
 {
-    std::cout << std::string((long long)depth * 3, ' ') << char(0xC0) << std::string(2, '-') << ">" << node->mName.C_Str();
+    out() << std::string((long long)depth * 3, ' ') << char(0xC0) << std::string(2, '-') << ">" << node->mName.C_Str();
     if (node->mTransformation.IsIdentity())
     {
-        std::cout << " (Identity Transform)";
+        out() << " (Identity Transform)";
     }
-    std::cout << "\n";
+    out() << "\n";
 
     for (UINT i = 0; i < node->mNumChildren; i++)
     {
@@ -1422,24 +2043,6 @@ void ModelConverter::printAINodes(aiNode* node, int depth)
     }
 }
 
-void ModelConverter::printNodes(Node* node, int depth)
-{
-    std::cout << std::string((long long)depth * 3, ' ') << char(0xC0) << std::string(2, '-') << ">" << node->name;
-    if (node->transform.IsIdentity())
-    {
-        std::cout << " (Identity Transform)";
-    }
-    std::cout << "\n";
-
-    if (!node->transform.IsIdentity())
-        printAIMatrix(node->transform);
-
-    for (UINT i = 0; i < node->children.size(); i++)
-    {
-        printNodes(&node->children[i], depth + 1);
-    }
-}
-
 void ModelConverter::printAIMatrix(const aiMatrix4x4& m)
 {
     aiVector3D scale, translation, rotation;
@@ -1467,4 +2070,66 @@ aiMatrix4x4 ModelConverter::getGlobalTransform(aiNode* node)
     }
 
     return result;
-}
\ No newline at end of file
+}
+
+aiMatrix4x4 ModelConverter::toAIMatrix(const MatrixRecord& m)
+{
+    return aiMatrix4x4(m.m[0], m.m[1], m.m[2], m.m[3],
+                       m.m[4], m.m[5], m.m[6], m.m[7],
+                       m.m[8], m.m[9], m.m[10], m.m[11],
+                       m.m[12], m.m[13], m.m[14], m.m[15]);
+}
+
+std::string ModelConverter::ask(const std::string& question, bool batch, const std::map<std::string, std::string>& answers, const std::string& key)
+{
+    std::string answer;
+
+    out() << question;
+
+    if (!batch)
+    {
+        std::getline(std::cin, answer);
+        return answer;
+    }
+
+    auto it = answers.find(key);
+
+    if (it == answers.end())
+    {
+        it = answers.find("*");
+    }
+
+    if (it != answers.end())
+    {
+        answer = it->second;
+    }
+
+    out() << answer << "\n";
+
+    return answer;
+}
+
+std::string ModelConverter::outputPath(const InitData& initData, const std::string& fileName)
+{
+    if (initData.outputDir.empty())
+    {
+        return fileName;
+    }
+
+    char last = initData.outputDir.back();
+
+    return initData.outputDir + (last == '/' || last == '\\' ? "" : "/") + fileName;
+}
+
+bool ModelConverter::claimOutput(const std::string& fileName)
+{
+    std::string other = outputClaims ? outputClaims->claim(fileName, stats.fileName) : "";
+
+    if (!other.empty())
+    {
+        std::cerr << fileName << " is written by both " << other << " and " << stats.fileName << "!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
@@ -9,15 +9,65 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <filesystem>
+#include <mutex>
 #include <Windows.h>
 #include <assimp\Importer.hpp>
 #include <assimp\scene.h>
 #include <assimp\postprocess.h>
+#include <assimp\config.h>
 #include <assimp\material.h>
 #include <assimp\version.h>
 #include <cmath>
 
 #include "data.h"
+#include "Format.h"
+#include "AnimationBaking.h"
+#include "AssetPack.h"
+#include "AssetReader.h"
+#include "BonePalette.h"
+#include "BuildCache.h"
+#include "ClipQuantization.h"
+#include "KeyFrameReduction.h"
+#include "MappedIOSystem.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Parallel.h"
+#include "PostProcess.h"
+#include "VertexTransform.h"
+#include "Version.h"
+
+/*
+Output paths claimed by the converters of a batch. Clip names are only known
+after the import, so every output is claimed right before it is written and
+two source files never write the same file.
+*/
+class OutputClaims
+{
+public:
+    /*
+    Claims an output path for a source file.
+    @returns Empty if the path is free or claimed by the same source, otherwise the other source
+    @param Path of the output
+    @param Source file writing it*/
+    std::string claim(const std::string& path, const std::string& source)
+    {
+        std::error_code ec;
+        std::string key = std::filesystem::absolute(path, ec).lexically_normal().string();
+
+        /*paths are case insensitive on Windows*/
+        std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = owners.emplace(key, source).first;
+
+        return it->second == source ? "" : it->second;
+    }
+
+private:
+    std::mutex mutex;
+    std::map<std::string, std::string> owners;
+};
 
 class ModelConverter
 {
@@ -34,7 +84,30 @@ public:
     bool process(const InitData& initData);
 
     /*
-    Print the contents of a B3D, S3D or CLP file to the command line.
+    Redirects the conversion output, e.g. to buffer it while converting
+    several files in parallel. The stream must outlive the converter.
+    @param Stream for all non-error output*/
+    void setOutput(std::ostream& stream) { outStream = &stream; }
+
+    /*
+    Shares the claimed output paths with the other converters of a batch, a
+    conversion fails instead of writing a file another source already wrote.
+    @param Claims, must outlive the converter*/
+    void setOutputClaims(OutputClaims& claims) { outputClaims = &claims; }
+
+    /*
+    Returns timing and sizes of the last call to process().
+    @returns Statistics of the last conversion*/
+    const ConversionStats& getStats() const { return stats; }
+
+    /*
+    Checks if the file can be converted, the own output formats are excluded.
+    @returns true if ASSIMP can import the file
+    @param Path to the file*/
+    bool isSupportedFile(const std::string& fileName) const;
+
+    /*
+    Print the contents of a B3D, S3D, CLP or PAK file to the command line.
     @param Path to the file
     @param verbose output*/
     void printFile(const std::string& fileName, bool verbose = true);
@@ -52,21 +125,31 @@ public:
 
 private:
     UnifiedModel model;
+    ConversionStats stats;
+    std::ostream* outStream = &std::cout;
+    OutputClaims* outputClaims = nullptr;
+
+    std::ostream& out() { return *outStream; }
 
+    bool convert(const InitData& initData);
+    bool restoreFromCache(const InitData& initData, const BuildCache& cache, const std::string& key);
     bool load(const aiScene* scene, const InitData& initData);
-    bool write();
-    bool writeAnimations();
-    void printB3D(const std::string& fileName, bool verbose = true);
-    void printS3D(const std::string& fileName, bool verbose = true);
+    void optimizeMeshes(const InitData& initData);
+    bool write(const InitData& initData);
+    bool writeLods(const InitData& initData, const std::string& baseName);
+    bool writeAnimations(const InitData& initData);
+    void printModel(const std::string& fileName, bool verbose = true);
     void printCLP(const std::string& fileName, bool verbose = true);
+    void printPack(const std::string& fileName, bool verbose = true);
 
-    static int findParentBone(const std::vector<Bone>& bones, const aiNode* node);
-    static int findIndexInBones(const std::vector<Bone>& bones, const std::string& name);
-    static bool existsBoneByName(const std::vector<Bone>& bones, const std::string& name);
-    static bool isInHierarchy(int index, const std::vector<std::pair<int, int>>& hierarchy);
-    static bool isInVector(std::vector<int>& arr, int index);
-    static void printAINodes(aiNode* node, int depth = 0);
-    static void printNodes(Node* node, int depth = 0);
+    static int findParentBone(const std::unordered_map<std::string, int>& boneIndices, const aiNode* node);
+    static int findIndexInBones(const std::unordered_map<std::string, int>& boneIndices, const std::string& name);
+    static bool buildBoneHierarchy(const std::vector<Bone>& bones, std::vector<std::pair<int, int>>& hierarchy);
+    void printAINodes(aiNode* node, int depth = 0);
     static void printAIMatrix(const aiMatrix4x4& m);
     static aiMatrix4x4 getGlobalTransform(aiNode* node);
+    static aiMatrix4x4 toAIMatrix(const MatrixRecord& m);
+    std::string ask(const std::string& question, bool batch, const std::map<std::string, std::string>& answers, const std::string& key);
+    static std::string outputPath(const InitData& initData, const std::string& fileName);
+    bool claimOutput(const std::string& fileName);
 };
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+/*
+Returns the number of threads to use if the user did not specify one.
+@returns Number of hardware threads, at least 1*/
+inline unsigned defaultThreadCount()
+{
+    unsigned count = std::thread::hardware_concurrency();
+    return count > 0 ? count : 1;
+}
+
+/*
+Runs task(index, worker) for every index in [0, count) on up to threadCount
+threads, the calling thread is worker 0. Indices are handed out one at a time
+so tasks of uneven length balance out. Returns when all tasks are finished.
+@param Number of tasks
+@param Maximum number of threads
+@param Task to run, receives the task index and the worker id in [0, threadCount)*/
+inline void parallelFor(size_t count, unsigned threadCount, const std::function<void(size_t, unsigned)>& task)
+{
+    threadCount = (unsigned)std::min<size_t>(std::max(threadCount, 1u), std::max<size_t>(count, 1));
+
+    if (threadCount == 1)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            task(i, 0);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+
+    auto worker = [&](unsigned id)
+    {
+        for (size_t i = next++; i < count; i = next++)
+        {
+            task(i, id);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount - 1);
+
+    for (unsigned t = 1; t < threadCount; t++)
+    {
+        threads.emplace_back(worker, t);
+    }
+
+    worker(0);
+
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+}
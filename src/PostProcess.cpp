@@ -0,0 +1,79 @@
+#include "PostProcess.h"
+
+const std::vector<PostProcessStep>& getPostProcessSteps()
+{
+    /*
+    Same order as assimp's step registry so applying them one by one matches a
+    single call. SplitLargeMeshes sits where assimp splits by vertex count,
+    its triangle split (earlier in assimp) does not depend on the steps between.
+    */
+    static const std::vector<PostProcessStep> steps =
+    {
+        { aiProcess_ValidateDataStructure, "ValidateDataStructure" }, // perform a full validation of the loader's output
+        { aiProcess_MakeLeftHanded, "MakeLeftHanded" }, // convert everything to D3D left handed space
+        { aiProcess_FlipUVs, "FlipUVs" },
+        { aiProcess_FlipWindingOrder, "FlipWindingOrder" },
+        { aiProcess_RemoveRedundantMaterials, "RemoveRedundantMaterials" }, // remove redundant materials
+        { aiProcess_FindInstances, "FindInstances" }, // search for instanced meshes and remove them by references to one master
+        { aiProcess_OptimizeMeshes, "OptimizeMeshes" }, // join small meshes, if possible
+        { aiProcess_GenUVCoords, "GenUVCoords" }, // convert spherical, cylindrical, box and planar mapping to proper UVs
+        { aiProcess_TransformUVCoords, "TransformUVCoords" }, // preprocess UV transformations (scaling, translation ...)
+        { aiProcess_Triangulate, "Triangulate" }, // triangulate polygons with more than 3 edges
+        { aiProcess_FindDegenerates, "FindDegenerates" }, // remove degenerated polygons from the import
+        { aiProcess_SortByPType, "SortByPType" }, // make 'clean' meshes which consist of a single typ of primitives
+        { aiProcess_FindInvalidData, "FindInvalidData" }, // detect invalid model data, such as invalid normal vectors
+        { aiProcess_SplitByBoneCount, "SplitByBoneCount" }, // split meshes with too many bones
+        { aiProcess_GenSmoothNormals, "GenSmoothNormals" }, // generate smooth normal vectors if not existing
+        { aiProcess_CalcTangentSpace, "CalcTangentSpace" }, // calculate tangents and bitangents if possible
+        { aiProcess_JoinIdenticalVertices, "JoinIdenticalVertices" }, // join identical vertices/ optimize indexing
+        { aiProcess_SplitLargeMeshes, "SplitLargeMeshes" }, // split large, unrenderable meshes into submeshes
+        { aiProcess_LimitBoneWeights, "LimitBoneWeights" }, // limit bone weights to the vertex influence slots
+        { aiProcess_ImproveCacheLocality, "ImproveCacheLocality" }, // improve the cache locality of the output vertices
+    };
+
+    return steps;
+}
+
+bool getPostProcessPreset(const std::string& name, unsigned int& flags)
+{
+    const unsigned int fast = aiProcess_ConvertToLeftHanded |
+        aiProcess_Triangulate |
+        aiProcess_SortByPType |
+        aiProcess_GenSmoothNormals |
+        aiProcess_CalcTangentSpace |
+        aiProcess_LimitBoneWeights;
+
+    const unsigned int preview = fast |
+        aiProcess_JoinIdenticalVertices |
+        aiProcess_GenUVCoords |
+        aiProcess_TransformUVCoords |
+        aiProcess_SplitLargeMeshes;
+
+    const unsigned int ship = preview |
+        aiProcess_ValidateDataStructure |
+        aiProcess_ImproveCacheLocality |
+        aiProcess_RemoveRedundantMaterials |
+        aiProcess_FindDegenerates |
+        aiProcess_FindInvalidData |
+        aiProcess_FindInstances |
+        aiProcess_OptimizeMeshes;
+
+    if (name == "fast")
+    {
+        flags = fast;
+    }
+    else if (name == "preview")
+    {
+        flags = preview;
+    }
+    else if (name == "ship")
+    {
+        flags = ship;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
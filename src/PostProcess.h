@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <assimp\postprocess.h>
+
+/*single assimp post-processing flag with a readable name*/
+struct PostProcessStep
+{
+    unsigned int flag;
+    const char* name;
+};
+
+/*
+Returns all post-processing steps the converter can use, in the order
+assimp executes them.
+@returns Steps in execution order*/
+const std::vector<PostProcessStep>& getPostProcessSteps();
+
+/*
+Returns the flags of a post-processing preset:
+fast    - only the steps the output format needs, vertices are not joined
+preview - fast plus joined vertices, uv generation and mesh splitting
+ship    - preview plus validation, cleanup and cache optimization
+@returns false if the preset is unknown
+@param Preset name
+@param Flags of the preset*/
+bool getPostProcessPreset(const std::string& name, unsigned int& flags);
@@ -0,0 +1,282 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+/*
+Scalar quantization helpers for the quantized vertex and clip encodings. Every
+encode function has a matching decode function used by the readers.
+*/
+
+/*maps [0, 1] to [0, 65535], values outside are clamped*/
+inline uint16_t encodeUnorm16(float v)
+{
+    v = std::min(std::max(v, 0.0f), 1.0f);
+    return (uint16_t)(v * 65535.0f + 0.5f);
+}
+
+inline float decodeUnorm16(uint16_t v)
+{
+    return v / 65535.0f;
+}
+
+/*maps [-1, 1] to [-32767, 32767], values outside are clamped*/
+inline int16_t encodeSnorm16(float v)
+{
+    v = std::min(std::max(v, -1.0f), 1.0f);
+    return (int16_t)std::lround(v * 32767.0f);
+}
+
+inline float decodeSnorm16(int16_t v)
+{
+    return std::max(v / 32767.0f, -1.0f);
+}
+
+/*IEEE 754 half precision with round to nearest even, overflow becomes infinity*/
+inline uint16_t encodeHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t abs = bits & 0x7fffffff;
+
+    /*nan and infinity*/
+    if (abs >= 0x7f800000)
+    {
+        return (uint16_t)(sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0));
+    }
+
+    /*too large for half*/
+    if (abs >= 0x477ff000)
+    {
+        return (uint16_t)(sign | 0x7c00);
+    }
+
+    /*normal half*/
+    if (abs >= 0x38800000)
+    {
+        uint32_t rounded = abs + 0xfff + ((abs >> 13) & 1) - 0x38000000;
+        return (uint16_t)(sign | (rounded >> 13));
+    }
+
+    /*subnormal half or zero*/
+    if (abs < 0x33000000)
+    {
+        return (uint16_t)sign;
+    }
+
+    uint32_t exponent = abs >> 23;
+    uint32_t mantissa = (abs & 0x7fffff) | 0x800000;
+    uint32_t shift = 126 - exponent;
+    uint32_t result = mantissa >> shift;
+    uint32_t remainder = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+
+    if (remainder > halfway || (remainder == halfway && (result & 1)))
+    {
+        result++;
+    }
+
+    return (uint16_t)(sign | result);
+}
+
+inline float decodeHalf(uint16_t half)
+{
+    uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    uint32_t bits;
+
+    if (exponent == 0x1f)
+    {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else if (exponent != 0)
+    {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    else if (mantissa == 0)
+    {
+        bits = sign;
+    }
+    else
+    {
+        /*subnormal half becomes a normal float*/
+        exponent = 113;
+
+        while (!(mantissa & 0x400))
+        {
+            mantissa <<= 1;
+            exponent--;
+        }
+
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+
+    return result;
+}
+
+/*
+Octahedral encoding of a unit vector as two snorm16 values. The vector is
+projected onto the octahedron |x| + |y| + |z| = 1 and the lower half is
+folded over the upper one. A zero vector encodes as +Z.
+*/
+inline void encodeOctahedral(float x, float y, float z, int16_t result[2])
+{
+    float length = std::fabs(x) + std::fabs(y) + std::fabs(z);
+
+    if (length == 0.0f)
+    {
+        result[0] = 0;
+        result[1] = 0;
+        return;
+    }
+
+    float u = x / length;
+    float v = y / length;
+
+    if (z < 0.0f)
+    {
+        float foldedU = (1.0f - std::fabs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+        float foldedV = (1.0f - std::fabs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+        u = foldedU;
+        v = foldedV;
+    }
+
+    result[0] = encodeSnorm16(u);
+    result[1] = encodeSnorm16(v);
+}
+
+inline void decodeOctahedral(const int16_t encoded[2], float result[3])
+{
+    float u = decodeSnorm16(encoded[0]);
+    float v = decodeSnorm16(encoded[1]);
+    float z = 1.0f - std::fabs(u) - std::fabs(v);
+
+    /*unfold the lower half*/
+    if (z < 0.0f)
+    {
+        float unfoldedU = (1.0f - std::fabs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+        float unfoldedV = (1.0f - std::fabs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+        u = unfoldedU;
+        v = unfoldedV;
+    }
+
+    float length = std::sqrt(u * u + v * v + z * z);
+
+    result[0] = u / length;
+    result[1] = v / length;
+    result[2] = z / length;
+}
+
+/*
+Quantizes blend weights to unorm8 values that sum to exactly 255, the
+rounding error is given to the largest weight. All zero weights stay zero.
+@param Weights to quantize
+@param Quantized weights
+@param Number of weights*/
+inline void encodeWeights(const float* weights, uint8_t* result, int count)
+{
+    float total = 0.0f;
+
+    for (int k = 0; k < count; k++)
+    {
+        total += std::max(weights[k], 0.0f);
+    }
+
+    if (total <= 0.0f)
+    {
+        std::fill(result, result + count, (uint8_t)0);
+        return;
+    }
+
+    int sum = 0;
+    int largest = 0;
+
+    for (int k = 0; k < count; k++)
+    {
+        result[k] = (uint8_t)std::lround(std::max(weights[k], 0.0f) / total * 255.0f);
+        sum += result[k];
+
+        if (weights[k] > weights[largest])
+        {
+            largest = k;
+        }
+    }
+
+    result[largest] = (uint8_t)(result[largest] + 255 - sum);
+}
+
+inline float decodeWeight(uint8_t weight)
+{
+    return weight / 255.0f;
+}
+
+/*
+Smallest three encoding of a unit quaternion in 48 bits. The largest
+component is dropped and made positive by negating the quaternion, the
+other three lie in [-1/sqrt(2), 1/sqrt(2)] and are stored with 15 bits each.
+Bits 0-1 hold the index of the dropped component.
+@param Quaternion x, y, z, w
+@param Three 16 bit words*/
+inline void encodeQuaternion(const float q[4], uint16_t result[3])
+{
+    int largest = 0;
+
+    for (int k = 1; k < 4; k++)
+    {
+        if (std::fabs(q[k]) > std::fabs(q[largest]))
+        {
+            largest = k;
+        }
+    }
+
+    float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+    uint64_t bits = (uint64_t)largest;
+    int shift = 2;
+
+    for (int k = 0; k < 4; k++)
+    {
+        if (k == largest) continue;
+
+        float v = std::min(std::max((q[k] * sign * 1.41421356f + 1.0f) * 0.5f, 0.0f), 1.0f);
+        bits |= (uint64_t)std::lround(v * 32767.0f) << shift;
+        shift += 15;
+    }
+
+    result[0] = (uint16_t)bits;
+    result[1] = (uint16_t)(bits >> 16);
+    result[2] = (uint16_t)(bits >> 32);
+}
+
+inline void decodeQuaternion(const uint16_t encoded[3], float result[4])
+{
+    uint64_t bits = (uint64_t)encoded[0] | ((uint64_t)encoded[1] << 16) | ((uint64_t)encoded[2] << 32);
+    int largest = (int)(bits & 3);
+    int shift = 2;
+    float sum = 0.0f;
+
+    for (int k = 0; k < 4; k++)
+    {
+        if (k == largest) continue;
+
+        result[k] = (((bits >> shift) & 0x7fff) / 32767.0f * 2.0f - 1.0f) * 0.70710678f;
+        sum += result[k] * result[k];
+        shift += 15;
+    }
+
+    result[largest] = std::sqrt(std::max(1.0f - sum, 0.0f));
+
+    float length = std::sqrt(sum + result[largest] * result[largest]);
+
+    for (int k = 0; k < 4; k++)
+    {
+        result[k] /= length;
+    }
+}
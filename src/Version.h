@@ -0,0 +1,5 @@
+#pragma once
+
+/*converter version, changing it invalidates all cached conversions*/
+const int VERSION_MAJOR = 2;
+const int VERSION_MINOR = 0;
@@ -0,0 +1,360 @@
+#include "VertexTransform.h"
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define VT_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(VT_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define VT_SSE2 1
+#endif
+
+/*MSVC allows AVX intrinsics in any function, GCC and Clang need the target per function*/
+#if defined(VT_SSE2) && defined(_MSC_VER)
+#define VT_AVX 1
+#define VT_TARGET_AVX
+#elif defined(VT_SSE2) && defined(__GNUC__)
+#define VT_AVX 1
+#define VT_TARGET_AVX __attribute__((target("avx")))
+#endif
+
+namespace
+{
+    /*all kernels read and write the vertex fields through these offsets*/
+    static_assert(offsetof(Vertex, Position) == 0, "Position must be the first vertex member");
+    static_assert(sizeof(aiVector3D) == 3 * sizeof(float), "aiVector3D must be three packed floats");
+
+    inline void transformPoint(const float m[3][4], float* p)
+    {
+        float x = p[0], y = p[1], z = p[2];
+
+        p[0] = m[0][0] * x + m[0][1] * y + m[0][2] * z + m[0][3];
+        p[1] = m[1][0] * x + m[1][1] * y + m[1][2] * z + m[1][3];
+        p[2] = m[2][0] * x + m[2][1] * y + m[2][2] * z + m[2][3];
+    }
+
+    /*directions of length zero (missing normals or tangents) stay zero*/
+    inline void transformDirection(const float m[3][3], float* d)
+    {
+        float x = d[0], y = d[1], z = d[2];
+
+        float rx = m[0][0] * x + m[0][1] * y + m[0][2] * z;
+        float ry = m[1][0] * x + m[1][1] * y + m[1][2] * z;
+        float rz = m[2][0] * x + m[2][1] * y + m[2][2] * z;
+
+        float lengthSq = rx * rx + ry * ry + rz * rz;
+
+        if (!(lengthSq > 0.0f))
+        {
+            d[0] = d[1] = d[2] = 0.0f;
+            return;
+        }
+
+        /*divided like the SIMD kernels, a multiply by the reciprocal rounds differently*/
+        float length = std::sqrt(lengthSq);
+
+        d[0] = rx / length;
+        d[1] = ry / length;
+        d[2] = rz / length;
+    }
+
+    void transformScalar(Vertex* vertices, size_t count, const VertexTransform& t)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            Vertex& v = vertices[i];
+
+            transformPoint(t.positionMatrix, &v.Position.x);
+
+            if (t.transformDirections)
+            {
+                transformDirection(t.normalMatrix, &v.Normal.x);
+                transformDirection(t.tangentMatrix, &v.TangentU.x);
+            }
+        }
+    }
+
+#ifdef VT_SSE2
+    /*
+    The kernels work on the packed vertices directly: the matrix is kept as
+    four column registers and every component of the input is broadcast, so
+    no shuffles are needed to transpose the vertex data. Only three lanes are
+    stored back so the neighbouring vertex members are not touched.
+    */
+    struct Columns
+    {
+        __m128 c[4];
+    };
+
+    Columns loadColumns(const float* m, int stride, bool translation)
+    {
+        Columns result;
+
+        for (int c = 0; c < 4; c++)
+        {
+            bool zero = c == 3 && !translation;
+            result.c[c] = zero ? _mm_setzero_ps() : _mm_set_ps(0.0f, m[2 * stride + c], m[stride + c], m[c]);
+        }
+
+        return result;
+    }
+
+    inline __m128 loadVector(const float* p)
+    {
+        return _mm_set_ps(0.0f, p[2], p[1], p[0]);
+    }
+
+    inline void storeVector(float* p, __m128 v)
+    {
+        _mm_storel_pi(reinterpret_cast<__m64*>(p), v);
+        _mm_store_ss(p + 2, _mm_movehl_ps(v, v));
+    }
+
+    inline __m128 multiply(const Columns& m, const float* p, bool translation)
+    {
+        __m128 r = _mm_mul_ps(m.c[0], _mm_set1_ps(p[0]));
+        r = _mm_add_ps(r, _mm_mul_ps(m.c[1], _mm_set1_ps(p[1])));
+        r = _mm_add_ps(r, _mm_mul_ps(m.c[2], _mm_set1_ps(p[2])));
+
+        return translation ? _mm_add_ps(r, m.c[3]) : r;
+    }
+
+    inline __m128 normalize(__m128 v)
+    {
+        /*the fourth lane is always zero so a full horizontal sum is the squared length*/
+        __m128 sq = _mm_mul_ps(v, v);
+        __m128 sum = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 3, 0, 1)));
+        sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 0, 3, 2)));
+
+        __m128 length = _mm_sqrt_ps(sum);
+        __m128 nonZero = _mm_cmpgt_ps(sum, _mm_setzero_ps());
+
+        return _mm_and_ps(_mm_div_ps(v, length), nonZero);
+    }
+
+    void transformSSE2(Vertex* vertices, size_t count, const VertexTransform& t)
+    {
+        Columns position = loadColumns(&t.positionMatrix[0][0], 4, true);
+        Columns normal = loadColumns(&t.normalMatrix[0][0], 3, false);
+        Columns tangent = loadColumns(&t.tangentMatrix[0][0], 3, false);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            Vertex& v = vertices[i];
+
+            storeVector(&v.Position.x, multiply(position, &v.Position.x, true));
+
+            if (t.transformDirections)
+            {
+                storeVector(&v.Normal.x, normalize(multiply(normal, &v.Normal.x, false)));
+                storeVector(&v.TangentU.x, normalize(multiply(tangent, &v.TangentU.x, false)));
+            }
+        }
+    }
+#endif
+
+#ifdef VT_AVX
+    /*
+    Same scheme as the SSE2 kernel with two vertices per 256 bit register,
+    the low half holds the first vertex and the high half the second one.
+    The operations and their order match the SSE2 kernel and no FMA is used,
+    so every level writes the same bits.
+    */
+    struct WideColumns
+    {
+        __m256 c[4];
+    };
+
+    VT_TARGET_AVX WideColumns widen(const Columns& m)
+    {
+        WideColumns result;
+
+        for (int c = 0; c < 4; c++)
+        {
+            result.c[c] = _mm256_insertf128_ps(_mm256_castps128_ps256(m.c[c]), m.c[c], 1);
+        }
+
+        return result;
+    }
+
+    VT_TARGET_AVX inline __m256 broadcastPair(const float* a, const float* b)
+    {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(*a)), _mm_set1_ps(*b), 1);
+    }
+
+    VT_TARGET_AVX inline __m256 multiplyPair(const WideColumns& m, const float* a, const float* b, bool translation)
+    {
+        __m256 r = _mm256_mul_ps(m.c[0], broadcastPair(a, b));
+        r = _mm256_add_ps(r, _mm256_mul_ps(m.c[1], broadcastPair(a + 1, b + 1)));
+        r = _mm256_add_ps(r, _mm256_mul_ps(m.c[2], broadcastPair(a + 2, b + 2)));
+
+        return translation ? _mm256_add_ps(r, m.c[3]) : r;
+    }
+
+    VT_TARGET_AVX inline __m256 normalizePair(__m256 v)
+    {
+        __m256 sq = _mm256_mul_ps(v, v);
+        __m256 sum = _mm256_add_ps(sq, _mm256_permute_ps(sq, _MM_SHUFFLE(2, 3, 0, 1)));
+        sum = _mm256_add_ps(sum, _mm256_permute_ps(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+
+        __m256 length = _mm256_sqrt_ps(sum);
+        __m256 nonZero = _mm256_cmp_ps(sum, _mm256_setzero_ps(), _CMP_GT_OQ);
+
+        return _mm256_and_ps(_mm256_div_ps(v, length), nonZero);
+    }
+
+    VT_TARGET_AVX inline void storePair(float* a, float* b, __m256 v)
+    {
+        storeVector(a, _mm256_castps256_ps128(v));
+        storeVector(b, _mm256_extractf128_ps(v, 1));
+    }
+
+    VT_TARGET_AVX void transformAVX(Vertex* vertices, size_t count, const VertexTransform& t)
+    {
+        WideColumns position = widen(loadColumns(&t.positionMatrix[0][0], 4, true));
+        WideColumns normal = widen(loadColumns(&t.normalMatrix[0][0], 3, false));
+        WideColumns tangent = widen(loadColumns(&t.tangentMatrix[0][0], 3, false));
+
+        size_t i = 0;
+
+        for (; i + 1 < count; i += 2)
+        {
+            Vertex& a = vertices[i];
+            Vertex& b = vertices[i + 1];
+
+            storePair(&a.Position.x, &b.Position.x, multiplyPair(position, &a.Position.x, &b.Position.x, true));
+
+            if (t.transformDirections)
+            {
+                storePair(&a.Normal.x, &b.Normal.x, normalizePair(multiplyPair(normal, &a.Normal.x, &b.Normal.x, false)));
+                storePair(&a.TangentU.x, &b.TangentU.x, normalizePair(multiplyPair(tangent, &a.TangentU.x, &b.TangentU.x, false)));
+            }
+        }
+
+        /*odd vertex count*/
+        if (i < count)
+        {
+            transformSSE2(vertices + i, count - i, t);
+        }
+    }
+#endif
+}
+
+VertexTransform makeVertexTransform(const aiVector3D& center, float scale, const aiMatrix4x4& root, bool applyRoot)
+{
+    VertexTransform result;
+
+    aiMatrix4x4 matrix = applyRoot ? root : aiMatrix4x4();
+
+    /*position = root * (scale * (p - center)) = (root3x3 * scale) * p + (root.translation - root3x3 * scale * center)*/
+    aiMatrix3x3 linear(matrix);
+    aiVector3D offset = linear * (center * -scale);
+
+    for (int r = 0; r < 3; r++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            result.positionMatrix[r][c] = linear[r][c] * scale;
+        }
+    }
+
+    result.positionMatrix[0][3] = matrix.a4 + offset.x;
+    result.positionMatrix[1][3] = matrix.b4 + offset.y;
+    result.positionMatrix[2][3] = matrix.c4 + offset.z;
+
+    /*directions are only affected by the root transform*/
+    aiMatrix3x3 normal = linear;
+
+    if (std::fabs(linear.Determinant()) > 1e-12f)
+    {
+        normal = aiMatrix3x3(linear).Inverse().Transpose();
+    }
+
+    for (int r = 0; r < 3; r++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            result.tangentMatrix[r][c] = linear[r][c];
+            result.normalMatrix[r][c] = normal[r][c];
+        }
+    }
+
+    result.transformDirections = applyRoot && !linear.IsIdentity();
+    result.isIdentity = !result.transformDirections && scale == 1.0f && center == aiVector3D()
+        && matrix.a4 == 0.0f && matrix.b4 == 0.0f && matrix.c4 == 0.0f;
+
+    return result;
+}
+
+SimdLevel detectSimdLevel()
+{
+#if defined(VT_AVX) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+
+    /*the OS must save the upper halves of the ymm registers*/
+    if (osxsave && avx && (_xgetbv(0) & 6) == 6)
+    {
+        return SimdLevel::AVX;
+    }
+
+    return SimdLevel::SSE2;
+#elif defined(VT_AVX)
+    if (__builtin_cpu_supports("avx"))
+    {
+        return SimdLevel::AVX;
+    }
+
+    return SimdLevel::SSE2;
+#elif defined(VT_SSE2)
+    return SimdLevel::SSE2;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+const char* getSimdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::AVX:
+        return "AVX";
+    case SimdLevel::SSE2:
+        return "SSE2";
+    default:
+        return "scalar";
+    }
+}
+
+void transformVertices(Vertex* vertices, size_t count, const VertexTransform& transform, SimdLevel level)
+{
+    if (transform.isIdentity || count == 0)
+    {
+        return;
+    }
+
+    switch (level)
+    {
+#ifdef VT_AVX
+    case SimdLevel::AVX:
+        transformAVX(vertices, count, transform);
+        return;
+#endif
+#ifdef VT_SSE2
+    case SimdLevel::SSE2:
+        transformSSE2(vertices, count, transform);
+        return;
+#endif
+    default:
+        transformScalar(vertices, count, transform);
+        return;
+    }
+}
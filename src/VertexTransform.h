@@ -0,0 +1,50 @@
+#pragma once
+
+#include "data.h"
+
+/*instruction sets the vertex transform kernel can use*/
+enum class SimdLevel
+{
+    Scalar,
+    SSE2,
+    AVX
+};
+
+/*
+Fused affine transform for positions, directions are transformed without
+translation: normals by the inverse transpose, tangents by the upper 3x3.
+Matrices are row major, position = positionMatrix * (p, 1).
+*/
+struct VertexTransform
+{
+    float positionMatrix[3][4];
+    float normalMatrix[3][3];
+    float tangentMatrix[3][3];
+    bool transformDirections = false;
+    bool isIdentity = true;
+};
+
+/*
+Builds the transform ((p - center) * scale) followed by the root transform.
+@returns Fused transform
+@param Center subtracted from positions
+@param Uniform scale applied to positions after centering
+@param Root transform, only applied if applyRoot is set
+@param Apply the root transform to positions, normals and tangents*/
+VertexTransform makeVertexTransform(const aiVector3D& center, float scale, const aiMatrix4x4& root, bool applyRoot);
+
+/*
+Returns the best instruction set supported by the CPU.
+@returns SIMD level*/
+SimdLevel detectSimdLevel();
+
+const char* getSimdLevelName(SimdLevel level);
+
+/*
+Transforms positions, normals and tangents of the vertices in place,
+normals and tangents are renormalized.
+@param Vertices to transform
+@param Number of vertices
+@param Transform to apply
+@param Instruction set to use, must be supported by the CPU*/
+void transformVertices(Vertex* vertices, size_t count, const VertexTransform& transform, SimdLevel level);
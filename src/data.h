@@ -4,19 +4,49 @@ typedef unsigned int UINT;
 typedef unsigned char BYTE;
 
 #include <assimp\Importer.hpp>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
-/*holds all data for a skinned vertex*/
+/*number of bone influence slots per vertex, S3D stores exactly this many per vertex*/
+#ifndef MAX_BONE_INFLUENCES
+#define MAX_BONE_INFLUENCES 4
+#endif
+
+static_assert(MAX_BONE_INFLUENCES == 4 || MAX_BONE_INFLUENCES == 8, "MAX_BONE_INFLUENCES must be 4 or 8");
+
+/*holds all data for a skinned vertex, unused influence slots are zero*/
 struct Vertex
 {
-    Vertex() : Position(), Texture(), Normal(), TangentU() {}
-    Vertex(aiVector3D p, aiVector3D t, aiVector3D n, aiVector3D tU) : Position(p), Texture(t), Normal(n), TangentU(tU) {}
+    Vertex() : Position(), Texture(), Normal(), TangentU(), BlendWeights(), BlendIndices(), NumInfluences(0) {}
+    Vertex(aiVector3D p, aiVector3D t, aiVector3D n, aiVector3D tU) : Position(p), Texture(t), Normal(n), TangentU(tU), BlendWeights(), BlendIndices(), NumInfluences(0) {}
+
+    /*
+    Adds a bone influence to the next free slot.
+    @returns false if all slots are already in use*/
+    bool addInfluence(UINT index, float weight)
+    {
+        if (NumInfluences >= MAX_BONE_INFLUENCES)
+        {
+            return false;
+        }
+
+        BlendIndices[NumInfluences] = index;
+        BlendWeights[NumInfluences] = weight;
+        NumInfluences++;
+
+        return true;
+    }
+
     aiVector3D Position;
     aiVector3D Texture;
     aiVector3D Normal;
     aiVector3D TangentU;
-    std::vector<float> BlendWeights;
-    std::vector<UINT> BlendIndices;
+    float BlendWeights[MAX_BONE_INFLUENCES];
+    UINT BlendIndices[MAX_BONE_INFLUENCES];
+    BYTE NumInfluences;
 };
 
 /**/
@@ -27,14 +57,8 @@ public:
     std::vector<UINT> indices;
     aiMatrix4x4 rootTransform;
     std::string materialName;
-};
-
-struct Node
-{
-    std::string name = "";
-    aiMatrix4x4 transform;
-    Node* parent = nullptr;
-    std::vector<Node> children;
+    /*bone of every blend index, empty if blend indices refer to the bones of the model directly*/
+    std::vector<UINT> bonePalette;
 };
 
 struct Bone
@@ -45,7 +69,6 @@ struct Bone
     std::string parentName;
     int parentIndex = -1;
     aiMatrix4x4 nodeTransform;
-    bool used = false;
 };
 
 struct KeyFrame
@@ -67,10 +90,43 @@ struct KeyFrame
     aiQuaternion rotationQuat;
 };
 
+/*largest deviations the key frame reduction may introduce*/
+struct KeyFrameTolerance
+{
+    float translation = 0.001f; /*model units*/
+    float rotation = 0.05f; /*degrees*/
+    float scale = 0.001f;
+};
+
+/*key of a single animation channel*/
+struct VectorKey
+{
+    float timeStamp = 0.0f;
+    aiVector3D value;
+};
+
+struct RotationKey
+{
+    float timeStamp = 0.0f;
+    aiQuaternion value;
+};
+
+/*independent channels of a bone, each with its own key times*/
+struct BoneChannels
+{
+    std::vector<VectorKey> translation;
+    std::vector<RotationKey> rotation;
+    std::vector<VectorKey> scale;
+
+    bool empty() const { return translation.empty() && rotation.empty() && scale.empty(); }
+};
+
 struct Animation
 {
     std::string name;
     std::vector<std::vector<KeyFrame>> keyframes;
+    /*the source channels per bone, empty for bones without animation*/
+    std::vector<BoneChannels> channels;
 };
 
 struct UnifiedModel
@@ -79,6 +135,7 @@ struct UnifiedModel
     std::string fileName;
     std::vector<UnifiedMesh> meshes;
     std::vector<Bone> bones;
+    std::unordered_map<std::string, int> boneIndices; /*bone name to position in bones*/
     std::vector<std::pair<int, int>> boneHierarchy;
     std::vector<Animation> animations;
     aiNode* rootNode = nullptr;
@@ -94,17 +151,108 @@ struct InitData
     std::string prefix = "";
     bool forceStatic = false;
     bool forceTransform = false;
+    std::string outputDir = "";
+    /*threads used inside a single conversion, 0 uses all cores*/
+    unsigned threads = 0;
+    /*assimp post-processing preset: fast, preview or ship*/
+    std::string postProcess = "ship";
+    /*apply and time the post-processing steps one at a time*/
+    bool profilePostProcess = false;
+    /*reorder triangles and vertices for the vertex cache and overdraw after loading*/
+    bool optimizeMeshes = true;
+    /*write the extended format with quantized vertices*/
+    bool quantize = false;
+    /*write 16-bit indices for meshes with less than 65536 vertices*/
+    bool shortIndices = true;
+    /*triangle ratios of the generated LOD levels, descending, written as <name>_lod1, <name>_lod2, ..*/
+    std::vector<float> lods;
+    /*split the meshes into meshlets with culling bounds for gpu-driven rendering*/
+    bool meshlets = false;
+    /*drop key frames interpolation reproduces within the tolerance*/
+    bool reduceKeyFrames = false;
+    KeyFrameTolerance keyFrameTolerance;
+    /*write clips with separate translation, rotation and scale channels*/
+    bool channelClips = false;
+    /*write quantized channel clips, implies channelClips*/
+    bool quantizeClips = false;
+    /*resample clips at this rate in frames per second, 0 keeps the source keys*/
+    float bakeRate = 0.0f;
+    /*largest bone palette of a skinned mesh, meshes are split to fit, 0 disables palettes*/
+    size_t bonePaletteSize = 0;
+    /*directory of the conversion cache, empty disables it, only used in batch mode*/
+    std::string cacheDir = "";
+
+    /*batch mode answers all questions from the fields below instead of reading std::cin*/
+    bool batch = false;
+    /*mesh name -> material name, "*" is used for meshes without an entry*/
+    std::map<std::string, std::string> materials;
+    /*clip name -> new name and optional key frame selection ("name 0 50 100")*/
+    std::map<std::string, std::string> clips;
+    /*node used for meshes without a node, empty picks the first child of the root*/
+    std::string fallbackNode = "";
 
     friend std::ostream& operator<<(std::ostream& os, const InitData& id)
     {
         os << "File:\t\t" << id.fileName << "\nScale:\t\t" << id.scaleFactor << "\nCentering:\t" << (id.centerEnabled ? "On" : "Off") <<
             "\nForce static:\t" << (id.forceStatic ? "On" : "Off") <<
             "\nForce transform:\t" << (id.forceTransform ? "On" : "Off") <<
-            "\nPrefix:\t\t" << (id.prefix.empty() ? "None" : id.prefix) << "\n";
+            "\nPrefix:\t\t" << (id.prefix.empty() ? "None" : id.prefix) <<
+            "\nOutput:\t\t" << (id.outputDir.empty() ? "Working directory" : id.outputDir) <<
+            "\nMode:\t\t" << (id.batch ? "Batch" : "Interactive") <<
+            "\nThreads:\t" << (id.threads > 0 ? std::to_string(id.threads) : "All") <<
+            "\nPost-process:\t" << id.postProcess << (id.profilePostProcess ? " (profiled)" : "") <<
+            "\nOptimize:\t" << (id.optimizeMeshes ? "On" : "Off") <<
+            "\nVertices:\t" << (id.quantize ? "Quantized" : "Full precision") <<
+            "\nIndices:\t" << (id.shortIndices ? "16/32 bit" : "32 bit") <<
+            "\nLODs:\t\t";
+
+        for (size_t i = 0; i < id.lods.size(); i++)
+        {
+            os << (i > 0 ? ", " : "") << id.lods[i];
+        }
+
+        os << (id.lods.empty() ? "Off" : "") <<
+            "\nMeshlets:\t" << (id.meshlets ? "On" : "Off") <<
+            "\nBone palettes:\t" << (id.bonePaletteSize > 0 ? std::to_string(id.bonePaletteSize) + " bones" : "Off") <<
+            "\nKey frames:\t";
+
+        if (id.bakeRate > 0.0f)
+        {
+            os << "Baked at " << id.bakeRate << " Hz";
+        }
+        else if (id.reduceKeyFrames)
+        {
+            os << "Reduced (" << id.keyFrameTolerance.translation << ", " << id.keyFrameTolerance.rotation << " deg, " << id.keyFrameTolerance.scale << ")";
+        }
+        else
+        {
+            os << "All";
+        }
+
+        os << (id.quantizeClips ? " in quantized channels" : id.channelClips ? " in channels" : "");
+
+        os <<
+            "\nCache:\t\t" << (id.cacheDir.empty() ? "Off" : id.cacheDir) << "\n";
         return os;
     }
 };
 
+/*timing and sizes of a single file conversion*/
+struct ConversionStats
+{
+    std::string fileName = "";
+    bool success = false;
+    double milliseconds = 0.0;
+    double importMilliseconds = 0.0; /*reading and parsing the source*/
+    double postProcessMilliseconds = 0.0; /*assimp post-processing steps*/
+    std::vector<std::pair<std::string, double>> postProcessSteps; /*only filled when profiling*/
+    long long inputBytes = 0;
+    long long outputBytes = 0;
+    std::vector<std::string> outputFiles;
+    std::vector<std::string> inputFiles; /*source and the files the importer loaded with it, e.g. buffers and materials*/
+    bool cached = false; /*outputs were copied from the conversion cache*/
+};
+
 static std::vector<std::string> split(const std::string& str, char del)
 {
     std::vector<std::string> result;
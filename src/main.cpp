@@ -1,13 +1,352 @@
 #include "modelconverter.h"
+#include "Manifest.h"
+#include "Parallel.h"
+#include <filesystem>
+#include <mutex>
 
-const int VERSION_MAJOR = 1;
-const int VERSION_MINOR = 1;
+/*input file and its path relative to the input it was found in*/
+struct BatchFile
+{
+    std::filesystem::path path;
+    std::filesystem::path relative;
+};
+
+/*prints the aggregate timing of a batch conversion*/
+static void printReport(const std::vector<ConversionStats>& results, double wallMs, unsigned threadCount)
+{
+    int failed = 0;
+    int cached = 0;
+    double busyMs = 0.0;
+    double importMs = 0.0;
+    double postProcessMs = 0.0;
+    long long inputBytes = 0;
+    long long outputBytes = 0;
+
+    for (const auto& r : results)
+    {
+        failed += r.success ? 0 : 1;
+        cached += r.cached ? 1 : 0;
+        busyMs += r.milliseconds;
+        importMs += r.importMilliseconds;
+        postProcessMs += r.postProcessMilliseconds;
+        inputBytes += r.inputBytes;
+        outputBytes += r.outputBytes;
+    }
+
+    double wallSeconds = std::max(wallMs, 0.001) / 1000.0;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "\n===================================================\n\n";
+    std::cout << "Converted " << results.size() - failed << " of " << results.size() << " file(s) on " << threadCount << " thread(s).\n\n";
+    if (cached > 0)
+    {
+        std::cout << "Cache:\t\t" << cached << " file(s) restored, " << results.size() - failed - cached << " converted\n";
+    }
+
+    std::cout << "Wall time:\t" << wallMs << "ms (" << busyMs << "ms summed over files)\n";
+    std::cout << "Import:\t\t" << importMs << "ms reading, " << postProcessMs << "ms post-processing (summed over files)\n";
+    std::cout << "Input:\t\t" << inputBytes / 1048576.0 << " MB (" << inputBytes / 1048576.0 / wallSeconds << " MB/s)\n";
+    std::cout << "Output:\t\t" << outputBytes / 1048576.0 << " MB (" << outputBytes / 1048576.0 / wallSeconds << " MB/s)\n";
+    std::cout << "Throughput:\t" << results.size() / wallSeconds << " files/s\n";
+
+    /*slowest files first*/
+    std::vector<const ConversionStats*> sorted;
+
+    for (const auto& r : results)
+    {
+        sorted.push_back(&r);
+    }
+
+    std::sort(sorted.begin(), sorted.end(), [](const ConversionStats* a, const ConversionStats* b) { return a->milliseconds > b->milliseconds; });
+
+    /*post-processing steps summed over all profiled files, slowest first*/
+    std::map<std::string, double> stepTotals;
+
+    for (const auto& r : results)
+    {
+        for (const auto& s : r.postProcessSteps)
+        {
+            stepTotals[s.first] += s.second;
+        }
+    }
+
+    if (!stepTotals.empty())
+    {
+        std::vector<std::pair<std::string, double>> steps(stepTotals.begin(), stepTotals.end());
+        std::sort(steps.begin(), steps.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+
+        std::cout << "\nPost-processing steps:\n";
+
+        for (const auto& s : steps)
+        {
+            std::cout << "  " << s.second << "ms\t" << s.first << " (" << 100.0 * s.second / std::max(postProcessMs, 0.001) << "%)\n";
+        }
+    }
+
+    std::cout << "\nPer file:\n";
+
+    for (const auto* r : sorted)
+    {
+        std::cout << (r->success ? (r->cached ? "c " : "  ") : "! ") << r->milliseconds << "ms\t" << r->fileName << "\n";
+    }
+}
+
+/*converts files and all supported files below directories without user interaction*/
+static int convertBatch(const std::vector<std::string>& inputs, const InitData& baseData, const std::string& manifestFile, unsigned threadCount)
+{
+    namespace fs = std::filesystem;
+
+    Manifest manifest;
+
+    if (!manifestFile.empty() && !manifest.load(manifestFile))
+    {
+        return -1;
+    }
+
+    /*collect input files*/
+    ModelConverter probe;
+    std::error_code ec;
+    std::vector<BatchFile> files;
+
+    for (const auto& input : inputs)
+    {
+        fs::path root = fs::path(input);
+
+        if (fs::is_directory(root, ec))
+        {
+            std::vector<BatchFile> found;
+
+            for (const auto& entry : fs::recursive_directory_iterator(root, ec))
+            {
+                if (entry.is_regular_file(ec) && probe.isSupportedFile(entry.path().string()))
+                {
+                    found.push_back({ entry.path(), entry.path().lexically_relative(root) });
+                }
+            }
+
+            std::sort(found.begin(), found.end(), [](const BatchFile& a, const BatchFile& b) { return a.path < b.path; });
+            files.insert(files.end(), found.begin(), found.end());
+        }
+        else
+        {
+            files.push_back({ root, root.filename() });
+        }
+    }
+
+    /*settings of every file, the output directory mirrors the input directory tree*/
+    std::vector<InitData> jobs(files.size(), baseData);
+    OutputClaims claims;
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        InitData& initData = jobs[i];
+        initData.fileName = files[i].path.string();
+        initData.batch = true;
+
+        manifest.apply(files[i].relative.generic_string(), initData);
+
+        if (!baseData.outputDir.empty())
+        {
+            fs::path outputDir = fs::path(baseData.outputDir) / files[i].relative.parent_path();
+            fs::create_directories(outputDir, ec);
+            initData.outputDir = outputDir.string();
+        }
+
+        /*models and their LODs are named by the base name, the extension is only known after the import*/
+        std::string output = (fs::path(initData.outputDir) / (initData.prefix + files[i].path.stem().string())).string();
+        std::string other = claims.claim(output, initData.fileName);
+
+        if (!other.empty())
+        {
+            std::cerr << other << " and " << initData.fileName << " both convert to " << output << ", rename one of them or keep their directories apart with -out!" << std::endl;
+            return -1;
+        }
+    }
+
+    if (threadCount == 0)
+    {
+        threadCount = defaultThreadCount();
+    }
+
+    threadCount = (unsigned)std::max<size_t>(std::min<size_t>(threadCount, files.size()), 1);
+
+    std::cout << "Converting " << files.size() << " file(s) in batch mode on " << threadCount << " thread(s).\n\n";
+
+    /*one converter per worker, output is buffered per file when running in parallel*/
+    std::vector<ModelConverter> converters(threadCount);
+    std::vector<std::ostringstream> logs(threadCount);
+    std::vector<ConversionStats> results(files.size());
+    std::mutex printMutex;
+
+    /*clip names are only known after the import, so the converters claim every output they write*/
+    OutputClaims outputClaims;
+
+    for (unsigned t = 0; t < threadCount; t++)
+    {
+        converters[t].setOutputClaims(outputClaims);
+
+        if (threadCount > 1)
+        {
+            converters[t].setOutput(logs[t]);
+        }
+    }
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    parallelFor(files.size(), threadCount, [&](size_t i, unsigned worker)
+    {
+        InitData initData = jobs[i];
+
+        /*files converted in parallel do not split up further*/
+        initData.threads = threadCount > 1 ? 1 : 0;
+
+        bool success = converters[worker].process(initData);
+        results[i] = converters[worker].getStats();
+
+        std::lock_guard<std::mutex> lock(printMutex);
+
+        if (threadCount > 1)
+        {
+            std::cout << logs[worker].str() << std::flush;
+            logs[worker].str("");
+        }
+
+        if (!success)
+        {
+            std::cerr << "Model conversion of " << initData.fileName << " failed!" << std::endl;
+        }
+    });
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+
+    printReport(results, std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() / 1000.0, threadCount);
+
+    for (const auto& r : results)
+    {
+        if (!r.success)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*packs converted files and all converted files below directories into one archive*/
+static int packFiles(int argc, char* argv[])
+{
+    namespace fs = std::filesystem;
+
+    PackOptions options;
+    std::string packFile;
+    std::vector<PackInput> files;
+    std::error_code ec;
+
+    auto isConverted = [](const fs::path& path)
+    {
+        std::string ext = path.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return (char)tolower(c); });
+
+        return ext == ".b3d" || ext == ".s3d" || ext == ".clp";
+    };
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::vector<std::string> sVec = split(argv[i], '=');
+
+        /*the pack followed by its inputs*/
+        if (argv[i][0] != '-')
+        {
+            fs::path root = fs::path(argv[i]);
+
+            if (packFile.empty())
+            {
+                packFile = argv[i];
+            }
+            else if (fs::is_directory(root, ec))
+            {
+                std::vector<fs::path> found;
+
+                for (const auto& entry : fs::recursive_directory_iterator(root, ec))
+                {
+                    if (entry.is_regular_file(ec) && isConverted(entry.path()))
+                    {
+                        found.push_back(entry.path());
+                    }
+                }
+
+                std::sort(found.begin(), found.end());
+
+                for (const auto& path : found)
+                {
+                    files.push_back({ path.string(), path.lexically_relative(root).generic_string() });
+                }
+            }
+            else
+            {
+                files.push_back({ root.string(), root.filename().generic_string() });
+            }
+        }
+        else if (sVec[0] == "-lz4" && sVec.size() == 1)
+        {
+            options.compress = true;
+        }
+        else if (sVec[0] == "-align" && sVec.size() == 2)
+        {
+            int alignment = atoi(sVec[1].c_str());
+
+            if (alignment <= 0 || alignment > 65536 || (alignment & (alignment - 1)) != 0)
+            {
+                std::cerr << "Invalid pack alignment " << sVec[1] << ", expected a power of two up to 65536" << std::endl;
+                continue;
+            }
+
+            options.alignment = (UINT)alignment;
+        }
+        else if (sVec[0] == "-j" && sVec.size() == 2)
+        {
+            options.threads = (unsigned)std::max(atoi(sVec[1].c_str()), 1);
+        }
+        else
+        {
+            std::cerr << "Unknown parameter " << argv[i] << std::endl;
+        }
+    }
+
+    if (packFile.empty() || files.empty())
+    {
+        std::cerr << "Expected the pack and at least one converted file or directory, e.g. pack assets.pak converted" << std::endl;
+        return -1;
+    }
+
+    std::cout << "Packing " << files.size() << " file(s) into " << packFile << ".\n\n";
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+    PackStats stats;
+
+    if (!writePack(packFile, files, options, stats))
+    {
+        return -1;
+    }
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Packed " << stats.entries << " file(s), " << stats.compressedEntries << " compressed, in "
+        << std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() / 1000.0 << "ms.\n";
+    std::cout << "Size:\t\t" << stats.inputBytes / 1048576.0 << " MB of files, " << stats.outputBytes / 1048576.0 << " MB pack\n";
+
+    return 0;
+}
 
 int main(int argc, char* argv[])
 {
     ModelConverter mConverter;
     InitData initData;
 
+    std::ios_base::sync_with_stdio(false);
+    std::cin.tie(NULL);
+
     std::cout << std::setprecision(2);
     std::cout << "ModelConverter B3D/S3D/CLP " << VERSION_MAJOR << "." << VERSION_MINOR << " (Assimp Version " << mConverter.getVersionString() << ")\n" << std::endl;
     std::cout << "===================================================\n\n";
@@ -18,13 +357,28 @@ int main(int argc, char* argv[])
         std::string empty;
         std::cout << "First parameter must be path to file or -h!\n";
         std::cout << "\nPossible parameters:\n";
-        std::cout << "-h\t- Help dialog\n-nc\t- Do not center the model (rigged models are never centered)\n-fs\t- Force a static model\n-ft\t- Force transformed vertices (only rigged models)\n-s\t- Scale the model by a factor (-s=2)\n-p\t- Prefix the output file with the entered string (-p=PRE_)\n-o\t- Print the data of a b3d/s3d/clp file (-ov for verbose output)\n" << std::endl;
+        std::cout << "-h\t- Help dialog\n-nc\t- Do not center the model (rigged models are never centered)\n-fs\t- Force a static model\n-ft\t- Force transformed vertices (only rigged models)\n-s\t- Scale the model by a factor (-s=2)\n-p\t- Prefix the output file with the entered string (-p=PRE_)\n-o\t- Print the data of a b3d/s3d/clp/pak file (-ov for verbose output)\n";
+        std::cout << "-b\t- Batch mode, never ask for input (implied for directories)\n-m\t- Batch mode with answers and options from a manifest (-m=manifest.txt)\n-out\t- Write the output files to a directory (-out=converted)\n-j\t- Number of threads, used for files in batch mode and for meshes otherwise (-j=4, default all cores)\n";
+        std::cout << "-pp\t- Post-processing preset: fast, preview or ship (-pp=fast, default ship)\n-pt\t- Time every post-processing step\n-noopt\t- Keep the triangle and vertex order of the post-processing\n-q\t- Quantize vertices (16 bit positions, half UVs, octahedral normals, 8 bit bone data)\n-i32\t- Always write 32 bit indices, keeps the plain B3D/S3D format unless quantized or the model has more than 255 meshes or bones\n-lod\t- Write simplified LOD files with the given triangle ratios (-lod=0.5,0.25 writes name_lod1 and name_lod2)\n-kr\t- Drop key frames interpolation reproduces (-kr=0.001,0.05,0.001 sets the translation, rotation in degrees and scale tolerances)\n-ml\t- Write meshlets of up to 64 vertices and 124 triangles with bounding spheres and normal cones\n-ch\t- Write clips with separate translation, rotation and scale channels, constant channels keep a single key\n-qa\t- Quantize clip channels (48 bit rotations, 16 bit translations and scales, no key times for uniform channels), implies -ch\n-bake\t- Resample clips to a fixed rate so they can be sampled by index (-bake=60, default 30), -kr only collapses constant channels\n-bp\t- Give every skinned mesh a bone palette, meshes with more bones are split (-bp=32, default 64)\n-cache\t- Reuse outputs of unchanged files from a cache directory in batch mode (-cache=.mconv_cache)\n\n";
+        std::cout << "Changed in 2.0: models are written in the sectioned b3dx/s3dx format (version 2) with 16 bit indices by default.\nLoaders that only read the plain b3df/s3df format need -i32, which writes it unless other options require the extended format.\n\n";
+        std::cout << "The first parameter can also be a directory, all supported files below it are converted.\nAdditional files and directories can follow, several inputs imply batch mode.\n\n";
+        std::cout << "Converted files are packed into a single archive with: pack assets.pak files or directories\n-lz4\t- Compress the entries that get smaller\n-align\t- Align the entries (-align=4096, default 16)\n-j\t- Number of threads\n" << std::endl;
         std::getline(std::cin, empty);
         return 0;
     }
 
+    if (std::string(argv[1]) == "pack")
+    {
+        int result = packFiles(argc, argv);
+        std::cout << "\n===================================================\n";
+        return result;
+    }
+
     /*command line parameter*/
     initData.fileName = argv[1];
+    std::vector<std::string> inputs = { initData.fileName };
+    std::string manifestFile;
+    unsigned threadCount = 0;
 
 #ifdef _DEBUG
     initData.fileName = "C:\\Users\\n_seh\\Desktop\\blender\\geo\\geo_walk.fbx";
@@ -34,6 +388,13 @@ int main(int argc, char* argv[])
     {
         std::vector<std::string> sVec = split(argv[i], '=');
 
+        /*further input files*/
+        if (argv[i][0] != '-')
+        {
+            inputs.push_back(argv[i]);
+            continue;
+        }
+
         if (sVec.size() == 1)
         {
             if (sVec[0] == "-nc")
@@ -48,6 +409,50 @@ int main(int argc, char* argv[])
             {
                 initData.forceTransform = true;
             }
+            else if (sVec[0] == "-q")
+            {
+                initData.quantize = true;
+            }
+            else if (sVec[0] == "-kr")
+            {
+                initData.reduceKeyFrames = true;
+            }
+            else if (sVec[0] == "-ml")
+            {
+                initData.meshlets = true;
+            }
+            else if (sVec[0] == "-ch")
+            {
+                initData.channelClips = true;
+            }
+            else if (sVec[0] == "-qa")
+            {
+                initData.quantizeClips = true;
+            }
+            else if (sVec[0] == "-bake")
+            {
+                initData.bakeRate = 30.0f;
+            }
+            else if (sVec[0] == "-bp")
+            {
+                initData.bonePaletteSize = DEFAULT_BONE_PALETTE_SIZE;
+            }
+            else if (sVec[0] == "-i32")
+            {
+                initData.shortIndices = false;
+            }
+            else if (sVec[0] == "-noopt")
+            {
+                initData.optimizeMeshes = false;
+            }
+            else if (sVec[0] == "-pt")
+            {
+                initData.profilePostProcess = true;
+            }
+            else if (sVec[0] == "-b")
+            {
+                initData.batch = true;
+            }
             else if (sVec[0] == "-o")
             {
                 mConverter.printFile(initData.fileName, false);
@@ -74,6 +479,78 @@ int main(int argc, char* argv[])
             {
                 initData.prefix = sVec[1];
             }
+            else if (sVec[0] == "-m")
+            {
+                manifestFile = sVec[1];
+            }
+            else if (sVec[0] == "-out")
+            {
+                initData.outputDir = sVec[1];
+            }
+            else if (sVec[0] == "-kr")
+            {
+                if (!parseKeyFrameTolerance(sVec[1], initData.keyFrameTolerance))
+                {
+                    std::cerr << "Invalid key frame tolerances " << sVec[1] << ", expected translation,rotation,scale" << std::endl;
+                    continue;
+                }
+
+                initData.reduceKeyFrames = true;
+            }
+            else if (sVec[0] == "-lod")
+            {
+                if (!parseLodRatios(sVec[1], initData.lods))
+                {
+                    std::cerr << "Invalid LOD ratios " << sVec[1] << ", expected descending ratios between 0 and 1" << std::endl;
+                    initData.lods.clear();
+                    continue;
+                }
+            }
+            else if (sVec[0] == "-pp")
+            {
+                unsigned int flags = 0;
+
+                if (!getPostProcessPreset(sVec[1], flags))
+                {
+                    std::cerr << "Unknown post-processing preset " << sVec[1] << ", using " << initData.postProcess << std::endl;
+                    continue;
+                }
+
+                initData.postProcess = sVec[1];
+            }
+            else if (sVec[0] == "-cache")
+            {
+                initData.cacheDir = sVec[1];
+            }
+            else if (sVec[0] == "-bake")
+            {
+                float rate = (float)atof(sVec[1].c_str());
+
+                if (!(rate > 0.0f))
+                {
+                    std::cerr << "Invalid bake rate " << sVec[1] << ", expected frames per second" << std::endl;
+                    continue;
+                }
+
+                initData.bakeRate = rate;
+            }
+            else if (sVec[0] == "-bp")
+            {
+                int size = atoi(sVec[1].c_str());
+
+                /*every triangle must fit into a palette*/
+                if (size < 3 * MAX_BONE_INFLUENCES)
+                {
+                    std::cerr << "Invalid bone palette size " << sVec[1] << ", expected at least " << 3 * MAX_BONE_INFLUENCES << " bones" << std::endl;
+                    continue;
+                }
+
+                initData.bonePaletteSize = (size_t)size;
+            }
+            else if (sVec[0] == "-j")
+            {
+                threadCount = (unsigned)std::max(atoi(sVec[1].c_str()), 1);
+            }
             else
             {
                 std::cerr << "Unknown parameter " << argv[i] << std::endl;
@@ -87,6 +564,15 @@ int main(int argc, char* argv[])
         }
     }
 
+    if (initData.batch || !manifestFile.empty() || inputs.size() > 1 || std::filesystem::is_directory(initData.fileName))
+    {
+        int result = convertBatch(inputs, initData, manifestFile, threadCount);
+        std::cout << "\n===================================================\n";
+        return result;
+    }
+
+    initData.threads = threadCount;
+
     if (!mConverter.process(initData))
     {
         std::cerr << "Model conversion failed!" << std::endl;